@@ -227,6 +227,10 @@ static GLuint program;
 static Canvas *C;
 static Rasterizer *R;
 
+// the shapes never change, so recreating the image can reuse
+// the spans they were rasterized to the first time
+static SpanCache spanCache;
+
 // do we need to do a display() call?
 static bool updateDisplay = true;
 
@@ -360,6 +364,9 @@ static void createImage( Rasterizer &R )
     // draw all our polygons
     makePolygons( R );
 
+    // drop the overdrawn pixels the depth test would hide anyway
+    R.C.compactPixels( true );
+
     // set up the OpenGL buffers
     shapes.createBuffers( R.C );
 }
@@ -403,14 +410,16 @@ static void display( void )
 
     // bind the vertex and element buffers,
     // and set up the attribute variables
-    shapes.selectBuffers( program, "vPosition", "vColor", NULL, NULL );
+    shapes.selectBuffers( program, "vPosition", "vColor", NULL, NULL,
+                         "vDepth" );
 
     // set up our scale factors for normalization
     GLuint sf = glGetUniformLocation( program, "sf" );
     glUniform2f( sf, 2.0f / (w_width - 1.0f), 2.0f / (w_height - 1.0f) );
 
-    // draw the shapes
-    glDrawElements( GL_POINTS, shapes.numElements, GL_UNSIGNED_INT, NULL );
+    // draw the shapes; the pixels share no vertices, so this
+    // is a non-indexed draw
+    shapes.drawBuffers( GL_POINTS );
 }
 
 ///
@@ -426,6 +435,9 @@ static bool init( void )
         return( false );
     }
 
+    // the pixels go to the GPU as shorts and bytes rather than floats
+    C->setPixelFormat( PIXELS_PACKED );
+
     R = new Rasterizer( w_height, *C );
 
     if( R == NULL ) {
@@ -434,6 +446,8 @@ static bool init( void )
         return( false );
     }
 
+    R->setSpanCache( &spanCache );
+
     // Check the OpenGL major version
     if( gl_maj < 3 ) {
         vshader = "v120.vert";
@@ -458,6 +472,10 @@ static bool init( void )
     glDepthFunc( GL_LEQUAL );
     glClearDepth( 1.0f );
 
+    // anti-aliased pixels carry their coverage in the alpha channel
+    glEnable( GL_BLEND );
+    glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+
     // create the geometry for our shapes.
     createImage( *R );
 
@@ -36,6 +36,10 @@
 BufferSet::BufferSet( void ) {
     // do this the easy way
     initBuffer();
+
+    // the texture outlives buffer rebuilds, so it is set up here
+    texture = 0;
+    texWidth = texHeight = 0;
 }
 
 ///
@@ -44,7 +48,15 @@ BufferSet::BufferSet( void ) {
 void BufferSet::initBuffer( void ) {
     vbuffer = ebuffer = 0;
     numElements = 0;
-    vSize = eSize = tSize = cSize = nSize = 0;
+    indexed = false;
+    numIndices = 0;
+    vSize = eSize = tSize = cSize = nSize = dSize = 0;
+    vComps = cComps = 4;
+    vType = cType = GL_FLOAT;
+    vNorm = cNorm = GL_FALSE;
+    dConst = 0.0f;
+    cOffset = nOffset = tOffset = dOffset = 0;
+    stride = 0;
     bufferInit = false;
 }
 
@@ -60,9 +72,18 @@ void BufferSet::dumpBuffer( const char *which ) {
     }
     cout << "initialized)" << endl;
     cout << "  IDs: v " << vbuffer << " e " << ebuffer <<
-        " #elements: " << numElements << endl;
+        " #elements: " << numElements;
+    if( indexed ) {
+        cout << " #indices: " << numIndices;
+    }
+    cout << endl;
     cout << "  Sizes:  v " << vSize << " e " << eSize <<
-        " t " << tSize << " c " << cSize << " n " << nSize << endl;
+        " t " << tSize << " c " << cSize << " n " << nSize <<
+        " d " << dSize << endl;
+    if( stride > 0 ) {
+        cout << "  Interleaved:  stride " << stride << " c " << cOffset <<
+            " n " << nOffset << " t " << tOffset << endl;
+    }
 }
 
 ///
@@ -88,15 +109,18 @@ GLuint BufferSet::makeBuffer( GLenum target, const void *data, GLsizei size ) {
 // createBuffers(canvas) create a set of buffers for the object
 //     currently held in 'canvas'.
 //
-// @param C     the Canvas we'll use for drawing
+// @param C            the Canvas we'll use for drawing
+// @param interleave   interleave the vertex data?
 ///
-void BufferSet::createBuffers( Canvas &C ) {
+void BufferSet::createBuffers( Canvas &C, bool interleave ) {
 
     // reset this BufferSet if it has already been used
     if( bufferInit ) {
         // must delete the existing buffer IDs first
         glDeleteBuffers( 1, &(vbuffer) );
-        glDeleteBuffers( 1, &(ebuffer) );
+        if( indexed ) {
+            glDeleteBuffers( 1, &(ebuffer) );
+        }
         // clear everything out
         initBuffer();
     }
@@ -113,6 +137,17 @@ void BufferSet::createBuffers( Canvas &C ) {
     //          [ colors    ]  RGBA         vSize
     //          [ normals   ]  XYZ          vSize+cSize
     //          [ t. coords ]  UV           vSize+cSize+nSize
+    //          [ depths    ]  Z            vSize+cSize+nSize+tSize
+    //
+    // all as floats, except for packed pixels:  their locations are
+    // XY shorts, their colors RGBA8, and their depths (only there if
+    // the canvas kept them) half floats
+    //
+    // interleaved, the same float data is arranged by vertex instead:
+    //
+    //          [ XYZW RGBA XYZ UV ] [ XYZW RGBA XYZ UV ] ...
+    //
+    // with whatever is absent left out of every vertex
     ///
 
     // get the vertex count
@@ -123,42 +158,120 @@ void BufferSet::createBuffers( Canvas &C ) {
         return;
     }
 
-    // OK, we have vertices!
-    float *points = C.getVertices();
-    // #bytes = number of elements * 4 floats/element * bytes/float
-    vSize = numElements * 4 * sizeof(float);
+    // get the element data; an element buffer is only worth having
+    // if the Canvas supplied real connectivity (i.e., shared vertices)
+    IndexView elements = C.indexData();
+    if( elements.count > 0 ) {
+        indexed = true;
+        numIndices = elements.count;
+        // #bytes = number of indices * bytes/index
+        eSize = numIndices * sizeof(GLuint);
+
+        // first, create the connectivity data
+        ebuffer = makeBuffer( GL_ELEMENT_ARRAY_BUFFER, elements.data, eSize );
+    }
 
-    // accumulate the total vertex buffer size
-    GLsizeiptr vbufSize = vSize;
+    // interleaved data is written straight into the buffer, so it
+    // is never copied whole on our side; if the buffer can't be
+    // mapped, the planar layout is used instead
+    if( interleave && C.getPixelFormat() == PIXELS_FLOAT ) {
+        InterleavedLayout layout = C.interleavedLayout();
+
+        stride = layout.stride * sizeof(float);
+        vbuffer = makeBuffer( GL_ARRAY_BUFFER, NULL, numElements * stride );
+
+        // the contents of a mapped buffer can be lost while it is
+        // mapped (e.g., on a display mode change); if so, redo them
+        GLboolean written = GL_FALSE;
+        void *dst;
+        while( !written &&
+               (dst = glMapBuffer( GL_ARRAY_BUFFER, GL_WRITE_ONLY )) ) {
+            C.interleaveInto( (float *) dst );
+            written = glUnmapBuffer( GL_ARRAY_BUFFER );
+        }
+
+        if( written ) {
+            vSize = numElements * 4 * sizeof(float);
+            if( layout.color >= 0 ) {
+                cSize = numElements * 4 * sizeof(float);
+                cOffset = layout.color * sizeof(float);
+            }
+            if( layout.normal >= 0 ) {
+                nSize = numElements * 3 * sizeof(float);
+                nOffset = layout.normal * sizeof(float);
+            }
+            if( layout.uv >= 0 ) {
+                tSize = numElements * 2 * sizeof(float);
+                tOffset = layout.uv * sizeof(float);
+            }
+
+            bufferInit = true;
+            return;
+        }
 
-    // get the color data (if there is any)
-    float *colors = C.getColors();
-    if( colors != NULL ) {
-        cSize = numElements * 4 * sizeof(float);
-        vbufSize += cSize;
+        glDeleteBuffers( 1, &vbuffer );
+        vbuffer = 0;
+        stride = 0;
     }
 
+    // OK, we have planar vertices!
+    const void *points, *colors;
+    const GLhalf *depths = NULL;
+
+    if( C.getPixelFormat() == PIXELS_FLOAT ) {
+        points = C.vertexData().data;
+        // #bytes = number of elements * 4 floats/element * bytes/float
+        vSize = numElements * 4 * sizeof(float);
+
+        // get the color data (if there is any)
+        colors = C.colorData().data;
+        if( colors != NULL ) {
+            cSize = numElements * 4 * sizeof(float);
+        }
+    } else {
+        PackedView pixels = C.packedData();
+        points = pixels.xy;
+        colors = pixels.rgba;
+        depths = pixels.z;
+
+        vSize = numElements * 2 * sizeof(GLshort);
+        vComps = 2;
+        vType = GL_SHORT;
+
+        cSize = numElements * 4 * sizeof(GLubyte);
+        cType = GL_UNSIGNED_BYTE;
+        cNorm = GL_TRUE;
+
+        if( depths != NULL ) {
+            dSize = numElements * sizeof(GLhalf);
+        } else {
+            dConst = pixels.depth;
+        }
+    }
+
+    // accumulate the total vertex buffer size
+    GLsizeiptr vbufSize = vSize + cSize + dSize;
+
     // get the normal data (if there is any)
-    float *normals = C.getNormals();
+    const float *normals = C.normalData().data;
     if( normals != NULL ) {
         nSize = numElements * 3 * sizeof(float);
         vbufSize += nSize;
     }
 
     // get the (u,v) data (if there is any)
-    float *uv = C.getUV();
+    const float *uv = C.uvData().data;
     if( uv != NULL ) {
         tSize = numElements * 2 * sizeof(float);
         vbufSize += tSize;
     }
 
-    // get the element data
-    GLuint *elements = C.getElements();
-    // #bytes = number of elements * bytes/element
-    eSize = numElements * sizeof(GLuint);
-
-    // first, create the connectivity data
-    ebuffer = makeBuffer( GL_ELEMENT_ARRAY_BUFFER, elements, eSize );
+    // offsets to subsequent sections are the sum of
+    // the preceding section sizes (in bytes)
+    cOffset = vSize;
+    nOffset = cOffset + cSize;
+    tOffset = nOffset + nSize;
+    dOffset = tOffset + tSize;
 
     // next, the vertex buffer, containing vertices and "extra" data
     // note that we use glBufferSubData() calls to do the copying
@@ -167,8 +280,6 @@ void BufferSet::createBuffers( Canvas &C ) {
     // copy in the location data
     glBufferSubData( GL_ARRAY_BUFFER, 0, vSize, points );
 
-    // offsets to subsequent sections are the sum of
-    // the preceding section sizes (in bytes)
     GLintptr offset = vSize;
 
     // add in the color data (if there is any)
@@ -189,20 +300,113 @@ void BufferSet::createBuffers( Canvas &C ) {
         offset += tSize;
     }
 
+    // and finally the depths (if there are any)
+    if( dSize > 0 ) {
+        glBufferSubData( GL_ARRAY_BUFFER, offset, dSize, depths );
+        offset += dSize;
+    }
+
     // sanity check!
     if( offset != vbufSize ) {
         cerr << "*** createBuffers: size mismatch, offset "
             << offset << " vbufSize " << vbufSize << endl;
     }
 
-    // NOTE:  'points', 'colors', and 'elements' are dynamically allocated,
-    // but we don't free them here because they will be freed at the next
-    // call to clear() or the get*() functions
+    // NOTE:  'points', 'colors', and 'elements' point directly into
+    // the Canvas, so no copies were made and there is nothing to free
 
     // finally, mark it as set up
     bufferInit = true;
 }
 
+///
+// createTexture(canvas) - upload the framebuffer held in 'canvas'
+//     as a single RGBA8 texture
+//
+// @param C     the Canvas we'll use for drawing
+///
+void BufferSet::createTexture( Canvas &C ) {
+
+    const GLubyte *pixels = C.getPixels();
+
+    // nothing to do unless the Canvas has a framebuffer
+    if( pixels == NULL ) {
+        return;
+    }
+
+    int w = C.getWidth();
+    int h = C.getHeight();
+
+    if( texture == 0 ) {
+        glGenTextures( 1, &texture );
+    }
+
+    glBindTexture( GL_TEXTURE_2D, texture );
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+
+    if( w == texWidth && h == texHeight ) {
+        // same size as before; just replace the contents
+        glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, w, h,
+                         GL_RGBA, GL_UNSIGNED_BYTE, pixels );
+    } else {
+        glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0,
+                      GL_RGBA, GL_UNSIGNED_BYTE, pixels );
+        // one texel per pixel, so no filtering is wanted
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+        texWidth = w;
+        texHeight = h;
+    }
+}
+
+///
+// updateTexture(canvas,r) - upload one rectangle of the framebuffer
+//     held in 'canvas' into the existing texture
+//
+// @param C     the Canvas we'll use for drawing
+// @param r     the rectangle to upload
+///
+void BufferSet::updateTexture( Canvas &C, Rect r ) {
+
+    const GLubyte *pixels = C.getPixels();
+
+    if( pixels == NULL ) {
+        return;
+    }
+
+    int w = C.getWidth();
+    int h = C.getHeight();
+
+    if( texture == 0 || w != texWidth || h != texHeight ) {
+        createTexture( C );
+        return;
+    }
+
+    // clip to the canvas
+    int x0 = r.x0 < 0 ? 0 : r.x0;
+    int y0 = r.y0 < 0 ? 0 : r.y0;
+    int x1 = r.x1 > w ? w : r.x1;
+    int y1 = r.y1 > h ? h : r.y1;
+    if( x0 >= x1 || y0 >= y1 ) {
+        return;
+    }
+
+    glBindTexture( GL_TEXTURE_2D, texture );
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+
+    // pick the rectangle out of the full-width rows
+    glPixelStorei( GL_UNPACK_ROW_LENGTH, w );
+    glPixelStorei( GL_UNPACK_SKIP_PIXELS, x0 );
+    glPixelStorei( GL_UNPACK_SKIP_ROWS, y0 );
+
+    glTexSubImage2D( GL_TEXTURE_2D, 0, x0, y0, x1 - x0, y1 - y0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, pixels );
+
+    glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+    glPixelStorei( GL_UNPACK_SKIP_PIXELS, 0 );
+    glPixelStorei( GL_UNPACK_SKIP_ROWS, 0 );
+}
+
 ///
 // selectBuffers() - bind the correct vertex and element buffers
 //
@@ -211,13 +415,15 @@ void BufferSet::createBuffers( Canvas &C ) {
 // @param vc        name of the color attribute variable (or NULL)
 // @param vn        name of the normal attribute variable (or NULL)
 // @param vt        name of the texture coord attribute variable (or NULL)
+// @param vd        name of the depth attribute variable (or NULL)
 ///
 void BufferSet::selectBuffers( GLuint program,
-    const char *vp, const char *vc, const char *vn, const char *vt ) {
+    const char *vp, const char *vc, const char *vn, const char *vt,
+    const char *vd ) {
 
     // bind the buffers
     glBindBuffer( GL_ARRAY_BUFFER, vbuffer );
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, ebuffer );
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, indexed ? ebuffer : 0 );
 
     // set up the vertex attribute variables
 
@@ -225,22 +431,18 @@ void BufferSet::selectBuffers( GLuint program,
     GLint loc = getAttribLoc( program , vp );
     if( loc >= 0 ) {
         glEnableVertexAttribArray( loc );
-        glVertexAttribPointer( loc, 4, GL_FLOAT, GL_FALSE, 0,
+        glVertexAttribPointer( loc, vComps, vType, vNorm, stride,
                                BUFFER_OFFSET(0) );
     }
 
-    // cumulative byte offset for subsequent data sections
-    int offset = vSize;
-
     // do we also want color?
     if( vc != NULL ) {
         loc = getAttribLoc( program, vc );
         if( loc >= 0 ) {
             glEnableVertexAttribArray( loc );
-            glVertexAttribPointer( loc, 4, GL_FLOAT, GL_FALSE, 0,
-                                   BUFFER_OFFSET(offset) );
+            glVertexAttribPointer( loc, cComps, cType, cNorm, stride,
+                                   BUFFER_OFFSET(cOffset) );
         }
-        offset += cSize;
     }
 
     // how about a surface normal?
@@ -248,10 +450,9 @@ void BufferSet::selectBuffers( GLuint program,
         loc = getAttribLoc( program, vn );
         if( loc >= 0 ) {
             glEnableVertexAttribArray( loc );
-            glVertexAttribPointer( loc, 3, GL_FLOAT, GL_FALSE, 0,
-                                   BUFFER_OFFSET(offset) );
+            glVertexAttribPointer( loc, 3, GL_FLOAT, GL_FALSE, stride,
+                                   BUFFER_OFFSET(nOffset) );
         }
-        offset += nSize;
     }
 
     // what about texture coordinates?
@@ -259,9 +460,45 @@ void BufferSet::selectBuffers( GLuint program,
         loc = getAttribLoc( program, vt );
         if( loc >= 0 ) {
             glEnableVertexAttribArray( loc );
-            glVertexAttribPointer( loc, 2, GL_FLOAT, GL_FALSE, 0,
-                                   BUFFER_OFFSET(offset) );
+            glVertexAttribPointer( loc, 2, GL_FLOAT, GL_FALSE, stride,
+                                   BUFFER_OFFSET(tOffset) );
         }
-        offset += tSize;
+    }
+
+    // and a separate depth?
+    if( vd != NULL ) {
+        loc = getAttribLoc( program, vd );
+        if( loc >= 0 ) {
+            if( dSize > 0 ) {
+                glEnableVertexAttribArray( loc );
+                glVertexAttribPointer( loc, 1, GL_HALF_FLOAT, GL_FALSE, 0,
+                                       BUFFER_OFFSET(dOffset) );
+            } else {
+                // the same for every vertex
+                glDisableVertexAttribArray( loc );
+                glVertexAttrib1f( loc, dConst );
+            }
+        }
+    }
+}
+
+///
+// drawBuffers(mode) - draw the contents of the selected buffers
+//
+// Uses glDrawElements() if the Canvas supplied connectivity data,
+// and glDrawArrays() otherwise.
+//
+// @param mode   the primitive type (GL_POINTS, GL_TRIANGLES, etc.)
+///
+void BufferSet::drawBuffers( GLenum mode ) {
+
+    if( !bufferInit ) {
+        return;
+    }
+
+    if( indexed ) {
+        glDrawElements( mode, numIndices, GL_UNSIGNED_INT, BUFFER_OFFSET(0) );
+    } else {
+        glDrawArrays( mode, 0, numElements );
     }
 }
@@ -23,6 +23,8 @@
 
 #include <GLFW/glfw3.h>
 
+#include <stddef.h>
+
 using namespace std;
 
 #include "Canvas.h"
@@ -46,12 +48,36 @@ public:
     // total number of vertices
     int numElements;
 
+    // are we drawing through the element buffer, and with how
+    // many indices?  (non-indexed sets have no element buffer)
+    bool indexed;
+    int numIndices;
+
     // component sizes (bytes)
-    long vSize, eSize, tSize, cSize, nSize;
+    long vSize, eSize, tSize, cSize, nSize, dSize;
+
+    // layout of the location and color data:  components per vertex,
+    // their GL type, and whether integer types are normalized (to
+    // [0,1] or [-1,1]) rather than converted to float as they are
+    GLint vComps, cComps;
+    GLenum vType, cType;
+    GLboolean vNorm, cNorm;
+
+    // depth of every vertex, when there is no depth data (dSize 0)
+    GLfloat dConst;
+
+    // where each attribute starts (bytes; the location is at 0), and
+    // the distance from one vertex to the next (0 for planar sections)
+    long cOffset, nOffset, tOffset, dOffset;
+    GLsizei stride;
 
     // have these already been set up?
     bool bufferInit;
 
+    // framebuffer texture (dense Canvas only) and its dimensions
+    GLuint texture;
+    int texWidth, texHeight;
+
 public:
 
     ///
@@ -86,21 +112,70 @@ public:
     // createBuffers(canvas) - create a set of buffers for the object
     //     currently held in 'canvas'.
     //
+    // Packed pixels (see Canvas::setPixelFormat()) are uploaded as
+    // they are, with their depths (if kept) in a section of their own.
+    //
+    // Other data is normally uploaded as one section per kind of data;
+    // interleaved, each vertex's data is kept together instead (see
+    // Canvas::interleavedLayout()), which is kinder to the GPU's vertex
+    // fetch.  The records are written straight into the mapped buffer,
+    // without a copy of them on our side; should the buffer not map,
+    // the data goes up planar after all.
+    //
+    // @param C            the Canvas we'll use for drawing
+    // @param interleave   interleave the vertex data?
+    ///
+    void createBuffers( Canvas &C, bool interleave = false );
+
+    ///
+    // createTexture(canvas) - upload the framebuffer held in 'canvas'
+    //     as a single RGBA8 texture
+    //
     // @param C     the Canvas we'll use for drawing
     ///
-    void createBuffers( Canvas &C );
+    void createTexture( Canvas &C );
+
+    ///
+    // updateTexture(canvas,r) - upload one rectangle of the framebuffer
+    //     held in 'canvas' into the existing texture
+    //
+    // Falls back to createTexture() if there is no texture yet, or
+    // if the canvas is not the size the texture was made at.
+    //
+    // @param C     the Canvas we'll use for drawing
+    // @param r     the rectangle to upload
+    ///
+    void updateTexture( Canvas &C, Rect r );
 
     ///
     // selectBuffers() - bind the correct vertex and element buffers
     //
+    // Each attribute is described in the format its data was stored
+    // in.  The depth attribute is added to the position's z by the
+    // shaders:  it reads the depth section of packed pixels, and is
+    // otherwise held constant (0 for vertices which carry their own
+    // z, and the canvas' depth for packed pixels without depths).
+    //
     // @param program   GLSL program object
     // @param vp        name of the position attribute variable
     // @param vc        name of the color attribute variable (or NULL)
     // @param vn        name of the normal attribute variable (or NULL)
     // @param vt        name of the texture coord attribute variable (or NULL)
+    // @param vd        name of the depth attribute variable (or NULL)
     ///
     void selectBuffers( GLuint program,
-        const char *vp, const char * vc, const char *vn, const char *vt );
+        const char *vp, const char * vc, const char *vn, const char *vt,
+        const char *vd = NULL );
+
+    ///
+    // drawBuffers(mode) - draw the contents of the selected buffers
+    //
+    // Uses glDrawElements() if the Canvas supplied connectivity data,
+    // and glDrawArrays() otherwise.
+    //
+    // @param mode   the primitive type (GL_POINTS, GL_TRIANGLES, etc.)
+    ///
+    void drawBuffers( GLenum mode );
 
 };
 
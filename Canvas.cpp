@@ -13,16 +13,26 @@
 //
 //  This module provides two basic interfaces:  a pixel interface for
 //  simple 2D drawings, and a vertex interface for 3D drawings.  The pixel
-//  interface consists of two functions:
+//  interface consists of four functions:
 //
 //      addPixel()          adds a pixel using the current drawing color
 //      addPixelColor()     adds a pixel using the specified color
+//      addSpan()           adds a run of pixels using the current color
+//      addSpanColor()      adds a run of pixels using the specified color
 //
 //  These functions assume that every pixel should have a color, and
 //  ensure that both position and color data are added to the canvas
 //  when each is called.  As we're working in 2D, only the X and Y
 //  components of the pixel location are used, and the alpha channel
-//  of the color is forced to 1.0.
+//  of the color is forced to 1.0.  The one exception is addSpanBlend(),
+//  which keeps the alpha channel so that partly covered pixels (e.g.,
+//  anti-aliased polygon edges) can be blended over what is already
+//  there.
+//
+//  Spans are stored as compact (y, x0, x1, paint) records, and are
+//  only expanded into individual pixels when the vertex data is
+//  retrieved (or when a vertex is added after them, to preserve
+//  drawing order).
 //
 //  For 3D drawings, vertices, colors, surface normals, and texture
 //  coordinates are added separately.  Vertices are counted; the module
@@ -34,13 +44,134 @@
 //  sequence.
 ///
 
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
+#include <cmath>
 #include <iostream>
 #include <iomanip>
 
 // Canvas.h includes all the OpenGL/GLFW/etc. header files for us
 #include "Canvas.h"
 #include "Vector.h"
+#include "SpanKernels.h"
+
+///
+// Packed pixel components
+///
+
+///
+// Convert a coordinate to a short
+///
+static inline GLshort toShort( float v )
+{
+    return (GLshort) floorf( fminf( fmaxf( v, -32768.0f ), 32767.0f ) + 0.5f );
+}
+
+///
+// Convert a float to a half float (rounding to nearest even)
+///
+static inline GLhalf toHalf( float f )
+{
+    uint32_t b;
+    memcpy( &b, &f, sizeof(b) );
+
+    uint32_t sign = (b >> 16) & 0x8000;
+    int bexp = (int) ((b >> 23) & 0xff);
+    uint32_t m = b & 0x7fffff;
+
+    // infinity and NaN
+    if( bexp == 0xff ) {
+        return (GLhalf) (sign | 0x7c00 | (m ? 0x200 : 0));
+    }
+
+    int e = bexp - 127 + 15;
+    if( e >= 31 ) {
+        return (GLhalf) (sign | 0x7c00);
+    }
+
+    // too small for a normal half:  denormalize, or flush to zero
+    int shift = 13;
+    uint32_t h;
+    if( e <= 0 ) {
+        if( e < -10 ) {
+            return (GLhalf) sign;
+        }
+        m |= 0x800000;
+        shift = 14 - e;
+        h = m >> shift;
+    } else {
+        h = ((uint32_t) e << 10) | (m >> 13);
+    }
+
+    // a carry out of the mantissa correctly bumps the exponent
+    uint32_t rest = m & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+    if( rest > halfway || (rest == halfway && (h & 1)) ) {
+        ++h;
+    }
+
+    return (GLhalf) (sign | h);
+}
+
+///
+// Convert a half float to a float
+///
+static inline float fromHalf( GLhalf h )
+{
+    int e = (h >> 10) & 0x1f, m = h & 0x3ff;
+    float f;
+
+    if( e == 0 ) {
+        f = ldexpf( (float) m, -24 );
+    } else if( e == 0x1f ) {
+        f = m ? NAN : INFINITY;
+    } else {
+        f = ldexpf( (float) (m | 0x400), e - 25 );
+    }
+
+    return (h & 0x8000) ? -f : f;
+}
+
+///
+// Pack a color as R, G, B, A bytes in memory
+///
+static inline GLuint toRGBA8( Color c )
+{
+    GLubyte rgba[4] = {
+        (GLubyte) (fminf( fmaxf( c.r, 0.0f ), 1.0f ) * 255.0f + 0.5f),
+        (GLubyte) (fminf( fmaxf( c.g, 0.0f ), 1.0f ) * 255.0f + 0.5f),
+        (GLubyte) (fminf( fmaxf( c.b, 0.0f ), 1.0f ) * 255.0f + 0.5f),
+        (GLubyte) (fminf( fmaxf( c.a, 0.0f ), 1.0f ) * 255.0f + 0.5f)
+    };
+    GLuint pix;
+    memcpy( &pix, rgba, sizeof(pix) );
+
+    return pix;
+}
+
+///
+// Copy one vertex's worth of one kind of data into its record
+// (vertices the data falls short of get zeroes)
+//
+// @param N     Values per vertex
+// @param src   The data, N values per vertex
+// @param i     The vertex
+// @param dst   Its slot in the vertex's record
+///
+template<int N>
+static inline void interleave( const vector<float> &src, int i, float *dst )
+{
+    if( (size_t) (i + 1) * N <= src.size() ) {
+        const float *s = &src[i * N];
+        for( int k = 0; k < N; ++k ) {
+            dst[k] = s[k];
+        }
+    } else {
+        for( int k = 0; k < N; ++k ) {
+            dst[k] = 0.0f;
+        }
+    }
+}
 
 ///
 // Constructor
@@ -57,6 +188,13 @@ Canvas::Canvas( int w, int h ) : width(w), height(h) {
     uvArray = 0;
     elemArray = 0;
     numElements = 0;
+    spanPixels = 0;
+    format = PIXELS_FLOAT;
+    pixelDepth = -1.0f;
+    dense = false;
+    frameDirty = false;
+    meshElements = 0;
+    meshColors = 0;
 }
 
 ///
@@ -79,100 +217,967 @@ void Canvas::clear( void )
         delete [] pointArray;
         pointArray = 0;
     }
-    if( normalArray ) {
-        delete [] normalArray;
-        normalArray = 0;
+    if( normalArray ) {
+        delete [] normalArray;
+        normalArray = 0;
+    }
+    if( uvArray ) {
+        delete [] uvArray;
+        uvArray = 0;
+    }
+    if( elemArray ) {
+        delete [] elemArray;
+        elemArray = 0;
+    }
+    if( colorArray ) {
+        delete [] colorArray;
+        colorArray = 0;
+    }
+    points.clear();
+    normals.clear();
+    uv.clear();
+    colors.clear();
+    indices.clear();
+    pixelXY.clear();
+    pixelZ.clear();
+    pixelRGBA.clear();
+    spans.clear();
+    paints.clear();
+    spanPixels = 0;
+    numElements = 0;
+    meshElements = 0;
+    meshColors = 0;
+    currentColor = (Color) { 0.0f, 0.0f, 0.0f, 1.0f };
+    currentDepth = -1.0f;
+
+    // a dense canvas keeps its storage, but forgets its contents
+    if( dense ) {
+        fill( frame.begin(), frame.end(), 0 );
+        fill( depthPlane.begin(), depthPlane.end(), 1.0f );
+        frameDirty = true;
+    }
+}
+
+///
+// Clear one rectangle of a dense framebuffer
+//
+// @param r   The rectangle to clear
+///
+void Canvas::clearRect( Rect r )
+{
+    if( !dense ) {
+        return;
+    }
+
+    int x0 = max( r.x0, 0 ), x1 = min( r.x1, width );
+    int y0 = max( r.y0, 0 ), y1 = min( r.y1, height );
+    if( x0 >= x1 || y0 >= y1 ) {
+        return;
+    }
+
+    for( int y = y0; y < y1; ++y ) {
+        int row = y * width;
+        fill( frame.begin() + row + x0, frame.begin() + row + x1, 0 );
+        if( !depthPlane.empty() ) {
+            fill( depthPlane.begin() + row + x0,
+                  depthPlane.begin() + row + x1, 1.0f );
+        }
+    }
+
+    frameDirty = true;
+}
+
+///
+// Set the pixel Z coordinate
+//
+// @param d   The depth to use
+// @return    The old depth value
+///
+float Canvas::setDepth( float d )
+{
+    float r = currentDepth;
+
+    currentDepth = d;
+    return( r );
+}
+
+///
+// Set the current drawing color
+//
+// @param color   The desired color
+// @return The old color value
+///
+Color Canvas::setColor( Color color )
+{
+    Color old = currentColor;
+
+    currentColor = color;
+    return( old );
+}
+
+///
+// Get the current drawing color
+//
+// @return The current color
+///
+Color Canvas::getColor( void )
+{
+    return( currentColor );
+}
+
+///
+// Back the pixel interface with a dense framebuffer
+//
+// Any pixel data already in the canvas is discarded.
+//
+// @param useDepth   also keep a depth plane
+///
+void Canvas::useFramebuffer( bool useDepth )
+{
+    int n = width > 0 && height > 0 ? width * height : 0;
+
+    frame.assign( n, 0 );
+    if( useDepth ) {
+        // the far plane, in the same units as setDepth()
+        depthPlane.assign( n, 1.0f );
+    } else {
+        depthPlane.clear();
+    }
+
+    points.clear();
+    colors.clear();
+    pixelXY.clear();
+    pixelZ.clear();
+    pixelRGBA.clear();
+    spans.clear();
+    paints.clear();
+    spanPixels = 0;
+    numElements = 0;
+    meshElements = 0;
+    meshColors = 0;
+
+    dense = true;
+    frameDirty = true;
+}
+
+///
+// Is the pixel interface backed by a dense framebuffer?
+//
+// @return true if it is
+///
+bool Canvas::hasFramebuffer( void )
+{
+    return dense;
+}
+
+///
+// Choose the format the pixel interface keeps its pixels in
+//
+// Any pixel data already in the canvas is discarded.
+//
+// @param f   The format to use
+///
+void Canvas::setPixelFormat( PixelFormat f )
+{
+    format = f;
+
+    spans.clear();
+    paints.clear();
+    spanPixels = 0;
+
+    // a framebuffer keeps its pixels, and hands them over again
+    if( dense ) {
+        dropFramePixels();
+        frameDirty = true;
+        return;
+    }
+
+    points.clear();
+    colors.clear();
+    pixelXY.clear();
+    pixelZ.clear();
+    pixelRGBA.clear();
+    numElements = 0;
+}
+
+///
+// The format pixels are kept in
+//
+// @return The format
+///
+PixelFormat Canvas::getPixelFormat( void )
+{
+    return format;
+}
+
+///
+// Find one pixel of the pixel data
+//
+// @param i        The pixel
+// @param z        Its depth (out)
+// @param opaque   Does it hide what is beneath it? (out)
+// @return         Its location (y * width + x), or -1 if it is
+//                 off the canvas
+///
+int Canvas::pixelAt( int i, float &z, bool &opaque )
+{
+    int x, y;
+
+    if( format == PIXELS_FLOAT ) {
+        x = (int) floorf( points[i * 4] + 0.5f );
+        y = (int) floorf( points[i * 4 + 1] + 0.5f );
+        z = points[i * 4 + 2];
+        opaque = colors[i * 4 + 3] >= 1.0f;
+    } else {
+        GLubyte rgba[4];
+        memcpy( rgba, &pixelRGBA[i], sizeof(rgba) );
+        x = pixelXY[i * 2];
+        y = pixelXY[i * 2 + 1];
+        z = pixelZ.empty() ? pixelDepth : fromHalf( pixelZ[i] );
+        opaque = rgba[3] == 255;
+    }
+
+    if( x < 0 || x >= width || y < 0 || y >= height ) {
+        return -1;
+    }
+
+    return y * width + x;
+}
+
+///
+// Copy one pixel of the pixel data over another
+//
+// @param from   The pixel to copy
+// @param to     The pixel to replace
+///
+void Canvas::movePixel( int from, int to )
+{
+    if( format == PIXELS_FLOAT ) {
+        memcpy( &points[to * 4], &points[from * 4], 4 * sizeof(float) );
+        memcpy( &colors[to * 4], &colors[from * 4], 4 * sizeof(float) );
+    } else {
+        pixelXY[to * 2] = pixelXY[from * 2];
+        pixelXY[to * 2 + 1] = pixelXY[from * 2 + 1];
+        pixelRGBA[to] = pixelRGBA[from];
+        if( !pixelZ.empty() ) {
+            pixelZ[to] = pixelZ[from];
+        }
+    }
+}
+
+///
+// Drop the pixels which would not show on screen
+//
+// @param depthTest   Will the GL depth test the pixels?
+// @return            The number of pixels dropped
+///
+int Canvas::compactPixels( bool depthTest )
+{
+    if( dense ) {
+        return 0;
+    }
+
+    // pending spans become ordinary pixels first
+    expandSpans();
+
+    int n = numElements;
+    if( n == 0 || !indices.empty() ) {
+        return 0;
+    }
+    if( format == PIXELS_FLOAT &&
+        ( colors.size() != points.size() || !normals.empty() ||
+          !uv.empty() ) ) {
+        return 0;
+    }
+
+    // first, replay the pixels in order, noting where each one is
+    // (or that it is clipped away or fails the depth test), and the
+    // last opaque one to pass at each location
+    const int FAILED = -2;
+    lastOpaque.assign( width * height, -1 );
+    if( depthTest ) {
+        depthSoFar.assign( width * height, 1.0f );
+    }
+    pixelLoc.resize( n );
+
+    for( int i = 0; i < n; ++i ) {
+        float z;
+        bool opaque;
+        int at = pixelAt( i, z, opaque );
+        pixelLoc[i] = at;
+
+        // the GL clips away anything beyond the near and far planes
+        // before it is tested or drawn
+        if( !( z >= -1.0f && z <= 1.0f ) ) {
+            pixelLoc[i] = FAILED;
+            continue;
+        }
+        if( at < 0 ) {
+            continue;
+        }
+        if( depthTest ) {
+            if( !(z <= depthSoFar[at]) ) {
+                pixelLoc[i] = FAILED;
+                continue;
+            }
+            depthSoFar[at] = z;
+        }
+        if( opaque ) {
+            lastOpaque[at] = i;
+        }
+    }
+
+    // then keep those which passed, from the last opaque one on
+    int kept = 0;
+    for( int i = 0; i < n; ++i ) {
+        int at = pixelLoc[i];
+        if( at == FAILED || ( at >= 0 && i < lastOpaque[at] ) ) {
+            continue;
+        }
+        if( kept != i ) {
+            movePixel( i, kept );
+        }
+        ++kept;
+    }
+
+    if( format == PIXELS_FLOAT ) {
+        points.resize( kept * 4 );
+        colors.resize( kept * 4 );
+    } else {
+        pixelXY.resize( kept * 2 );
+        pixelRGBA.resize( kept );
+        if( !pixelZ.empty() ) {
+            pixelZ.resize( kept );
+        }
+    }
+    numElements = kept;
+
+    return n - kept;
+}
+
+///
+// Take a range of pixels back out of the pixel data
+//
+// @param first   The first pixel to remove
+// @param last    One past the last pixel to remove
+// @return        The number of pixels removed
+///
+int Canvas::removePixels( int first, int last )
+{
+    if( dense ) {
+        return 0;
+    }
+
+    // pending spans become ordinary pixels first
+    expandSpans();
+
+    first = max( first, 0 );
+    last = min( last, numElements );
+    if( first >= last || !indices.empty() ) {
+        return 0;
+    }
+    if( format == PIXELS_FLOAT &&
+        ( colors.size() != points.size() || !normals.empty() ||
+          !uv.empty() ) ) {
+        return 0;
+    }
+
+    if( format == PIXELS_FLOAT ) {
+        points.erase( points.begin() + first * 4,
+                      points.begin() + last * 4 );
+        colors.erase( colors.begin() + first * 4,
+                      colors.begin() + last * 4 );
+    } else {
+        pixelXY.erase( pixelXY.begin() + first * 2,
+                       pixelXY.begin() + last * 2 );
+        pixelRGBA.erase( pixelRGBA.begin() + first,
+                         pixelRGBA.begin() + last );
+        if( !pixelZ.empty() ) {
+            pixelZ.erase( pixelZ.begin() + first, pixelZ.begin() + last );
+        }
+    }
+    numElements -= last - first;
+
+    return last - first;
+}
+
+    /////////////////////////////////////
+    //
+    // Adding things to the Canvas
+    //
+    /////////////////////////////////////
+
+    /////////////////////////////////////
+    // 2D interface:  Setting pixels
+    /////////////////////////////////////
+
+///
+// Add a pixel using the current drawing color
+//
+// @param p   The pixel to be added
+///
+void Canvas::addPixel( Vertex p )
+{
+    if( dense ) {
+        int x = (int) floorf( p.x + 0.5f );
+        writeSpan( (int) floorf( p.y + 0.5f ), x, x + 1, currentColor );
+        return;
+    }
+
+    // keep pending spans ahead of this pixel
+    expandSpans();
+
+    // we assume that we're working in 2D, and ignore the Z
+    // coordinate that came in with the pixel location; we also
+    // ignore the alpha channel value for the current color
+    Color col = { currentColor.r, currentColor.g, currentColor.b, 1.0f };
+
+    pushPixel( p.x, p.y, currentDepth, col );
+}
+
+///
+// Add a pixel using the specified drawing color
+//
+// @param p     The pixel to be set
+// @param c     The desired color
+///
+void Canvas::addPixelColor( Vertex p, Color c )
+{
+    if( dense ) {
+        int x = (int) floorf( p.x + 0.5f );
+        writeSpan( (int) floorf( p.y + 0.5f ), x, x + 1, c );
+        return;
+    }
+
+    expandSpans();
+
+    Color col = { c.r, c.g, c.b, 1.0f };
+
+    pushPixel( p.x, p.y, currentDepth, col );
+}
+
+///
+// Add a run of pixels using the current drawing color
+//
+// @param y     The scanline
+// @param x0    The first pixel in the run
+// @param x1    One past the last pixel in the run
+///
+void Canvas::addSpan( int y, int x0, int x1 )
+{
+    addSpanColor( y, x0, x1, currentColor );
+}
+
+///
+// Add a run of pixels using the specified drawing color
+//
+// @param y     The scanline
+// @param x0    The first pixel in the run
+// @param x1    One past the last pixel in the run
+// @param c     The desired color
+///
+void Canvas::addSpanColor( int y, int x0, int x1, Color c )
+{
+    if( x1 <= x0 ) {
+        return;
+    }
+
+    if( dense ) {
+        writeSpan( y, x0, x1, c );
+        return;
+    }
+
+    // as with pixels, the alpha channel is forced to 1.0
+    Color col = { c.r, c.g, c.b, 1.0f };
+    Span s = { y, x0, x1, findPaint(col) };
+
+    spans.push_back( s );
+    spanPixels += x1 - x0;
+}
+
+///
+// Add a run of pixels to be blended over what is already there
+//
+// @param y     The scanline
+// @param x0    The first pixel in the run
+// @param x1    One past the last pixel in the run
+// @param c     The desired color, including its alpha
+///
+void Canvas::addSpanBlend( int y, int x0, int x1, Color c )
+{
+    if( x1 <= x0 ) {
+        return;
+    }
+
+    if( dense ) {
+        blendSpan( y, x0, x1, c );
+        return;
+    }
+
+    Span s = { y, x0, x1, findPaint(c) };
+
+    spans.push_back( s );
+    spanPixels += x1 - x0;
+}
+
+///
+// Add a run of pixels whose color changes linearly along it
+//
+// @param y     The scanline
+// @param x0    The first pixel in the run
+// @param x1    One past the last pixel in the run
+// @param c     The color of pixel x0
+// @param dc    The change in color from one pixel to the next
+///
+void Canvas::addSpanShaded( int y, int x0, int x1, Color c, Color dc )
+{
+    if( x1 <= x0 ) {
+        return;
+    }
+
+    if( dense ) {
+        shadeSpan( y, x0, x1, c, dc );
+        return;
+    }
+
+    expandSpans();
+
+    for( int x = x0; x < x1; ++x ) {
+        float i = (float) (x - x0);
+        Color col = {
+            fminf( fmaxf( c.r + i * dc.r, 0.0f ), 1.0f ),
+            fminf( fmaxf( c.g + i * dc.g, 0.0f ), 1.0f ),
+            fminf( fmaxf( c.b + i * dc.b, 0.0f ), 1.0f ),
+            1.0f
+        };
+        pushPixel( (float) x, (float) y, currentDepth, col );
+    }
+}
+
+///
+// Add a run of pixels, each with its own color
+//
+// @param y     The scanline
+// @param x0    The first pixel in the run
+// @param x1    One past the last pixel in the run
+// @param pix   The x1 - x0 pixel colors, as RGBA8
+///
+void Canvas::addSpanPixels( int y, int x0, int x1, const uint32_t *pix )
+{
+    if( x1 <= x0 ) {
+        return;
+    }
+
+    if( dense ) {
+        copySpan( y, x0, x1, pix );
+        return;
+    }
+
+    expandSpans();
+
+    for( int x = x0; x < x1; ++x ) {
+        GLubyte rgba[4];
+        memcpy( rgba, &pix[x - x0], 4 );
+
+        Color col = {
+            rgba[0] / 255.0f, rgba[1] / 255.0f, rgba[2] / 255.0f, 1.0f
+        };
+        pushPixel( (float) x, (float) y, currentDepth, col );
+    }
+}
+
+///
+// Write a run of pixels into the framebuffer
+//
+// @param y     The scanline
+// @param x0    The first pixel in the run
+// @param x1    One past the last pixel in the run
+// @param c     The desired color
+///
+void Canvas::writeSpan( int y, int x0, int x1, Color c )
+{
+    // clip to the canvas
+    if( y < 0 || y >= height ) {
+        return;
+    }
+    if( x0 < 0 ) {
+        x0 = 0;
+    }
+    if( x1 > width ) {
+        x1 = width;
+    }
+    if( x1 <= x0 ) {
+        return;
+    }
+
+    // pack as R, G, B, A bytes in memory (alpha forced to 1.0)
+    GLubyte rgba[4] = {
+        (GLubyte) (fminf( fmaxf( c.r, 0.0f ), 1.0f ) * 255.0f + 0.5f),
+        (GLubyte) (fminf( fmaxf( c.g, 0.0f ), 1.0f ) * 255.0f + 0.5f),
+        (GLubyte) (fminf( fmaxf( c.b, 0.0f ), 1.0f ) * 255.0f + 0.5f),
+        255
+    };
+    GLuint pix;
+    memcpy( &pix, rgba, sizeof(pix) );
+
+    uint32_t *row = (uint32_t *) &frame[ y * width ];
+
+    if( depthPlane.empty() ) {
+        spanFill( row + x0, x1 - x0, pix );
+    } else {
+        spanFillDepth( row + x0, &depthPlane[ y * width + x0 ], x1 - x0,
+                       pix, currentDepth );
+    }
+
+    frameDirty = true;
+}
+
+///
+// Blend a run of pixels into the framebuffer
+//
+// @param y     The scanline
+// @param x0    The first pixel in the run
+// @param x1    One past the last pixel in the run
+// @param c     The desired color, including its alpha
+///
+void Canvas::blendSpan( int y, int x0, int x1, Color c )
+{
+    // clip to the canvas
+    if( y < 0 || y >= height ) {
+        return;
+    }
+    if( x0 < 0 ) {
+        x0 = 0;
+    }
+    if( x1 > width ) {
+        x1 = width;
+    }
+    if( x1 <= x0 ) {
+        return;
+    }
+
+    GLubyte rgba[4] = {
+        (GLubyte) (fminf( fmaxf( c.r, 0.0f ), 1.0f ) * 255.0f + 0.5f),
+        (GLubyte) (fminf( fmaxf( c.g, 0.0f ), 1.0f ) * 255.0f + 0.5f),
+        (GLubyte) (fminf( fmaxf( c.b, 0.0f ), 1.0f ) * 255.0f + 0.5f),
+        (GLubyte) (fminf( fmaxf( c.a, 0.0f ), 1.0f ) * 255.0f + 0.5f)
+    };
+    GLuint pix;
+    memcpy( &pix, rgba, sizeof(pix) );
+
+    uint32_t *row = (uint32_t *) &frame[ y * width ];
+
+    if( depthPlane.empty() ) {
+        spanBlend( row + x0, x1 - x0, pix );
+    } else {
+        // blend each run of pixels which pass the depth test, and
+        // take their depth (as the GL does for blended fragments)
+        float *depth = &depthPlane[ y * width ];
+        int x = x0;
+        while( x < x1 ) {
+            while( x < x1 && !( currentDepth <= depth[x] ) ) {
+                ++x;
+            }
+            int run = x;
+            while( x < x1 && currentDepth <= depth[x] ) {
+                depth[x++] = currentDepth;
+            }
+            if( x > run ) {
+                spanBlend( row + run, x - run, pix );
+            }
+        }
+    }
+
+    frameDirty = true;
+}
+
+///
+// Write a run of linearly shaded pixels into the framebuffer
+//
+// @param y     The scanline
+// @param x0    The first pixel in the run
+// @param x1    One past the last pixel in the run
+// @param c     The color of pixel x0
+// @param dc    The change in color from one pixel to the next
+///
+void Canvas::shadeSpan( int y, int x0, int x1, Color c, Color dc )
+{
+    // clip to the canvas
+    if( y < 0 || y >= height ) {
+        return;
+    }
+    if( x0 < 0 ) {
+        c.r -= x0 * dc.r;
+        c.g -= x0 * dc.g;
+        c.b -= x0 * dc.b;
+        x0 = 0;
+    }
+    if( x1 > width ) {
+        x1 = width;
+    }
+    if( x1 <= x0 ) {
+        return;
+    }
+
+    // alpha forced to 1.0
+    float color[4] = { c.r, c.g, c.b, 1.0f };
+    float step[4] = { dc.r, dc.g, dc.b, 0.0f };
+
+    uint32_t *row = (uint32_t *) &frame[ y * width ];
+
+    if( depthPlane.empty() ) {
+        spanShade( row + x0, x1 - x0, color, step );
+    } else {
+        // shade a piece at a time, then keep the pixels which
+        // pass the depth test
+        float *depth = &depthPlane[ y * width ];
+        uint32_t piece[64];
+
+        for( int x = x0; x < x1; x += 64 ) {
+            int n = min( x1 - x, 64 );
+            float start[4] = {
+                color[0] + (x - x0) * step[0],
+                color[1] + (x - x0) * step[1],
+                color[2] + (x - x0) * step[2],
+                1.0f
+            };
+            spanShade( piece, n, start, step );
+            for( int i = 0; i < n; ++i ) {
+                if( currentDepth <= depth[x + i] ) {
+                    depth[x + i] = currentDepth;
+                    row[x + i] = piece[i];
+                }
+            }
+        }
+    }
+
+    frameDirty = true;
+}
+
+///
+// Copy a run of ready-made pixels into the framebuffer
+//
+// @param y     The scanline
+// @param x0    The first pixel in the run
+// @param x1    One past the last pixel in the run
+// @param pix   The pixels, as RGBA8
+///
+void Canvas::copySpan( int y, int x0, int x1, const uint32_t *pix )
+{
+    // clip to the canvas
+    if( y < 0 || y >= height ) {
+        return;
+    }
+    if( x0 < 0 ) {
+        pix -= x0;
+        x0 = 0;
     }
-    if( uvArray ) {
-        delete [] uvArray;
-        uvArray = 0;
+    if( x1 > width ) {
+        x1 = width;
     }
-    if( elemArray ) {
-        delete [] elemArray;
-        elemArray = 0;
+    if( x1 <= x0 ) {
+        return;
     }
-    if( colorArray ) {
-        delete [] colorArray;
-        colorArray = 0;
+
+    // alpha forced to 1.0
+    GLubyte opaque[4] = { 0, 0, 0, 255 };
+    uint32_t alpha;
+    memcpy( &alpha, opaque, sizeof(alpha) );
+
+    uint32_t *row = (uint32_t *) &frame[ y * width ];
+
+    if( depthPlane.empty() ) {
+        for( int x = x0; x < x1; ++x ) {
+            row[x] = pix[x - x0] | alpha;
+        }
+    } else {
+        float *depth = &depthPlane[ y * width ];
+        for( int x = x0; x < x1; ++x ) {
+            if( currentDepth <= depth[x] ) {
+                depth[x] = currentDepth;
+                row[x] = pix[x - x0] | alpha;
+            }
+        }
     }
-    points.clear();
-    normals.clear();
-    uv.clear();
-    colors.clear();
-    numElements = 0;
-    currentColor = (Color) { 0.0f, 0.0f, 0.0f, 1.0f };
-    currentDepth = -1.0f;
+
+    frameDirty = true;
 }
 
 ///
-// Set the pixel Z coordinate
+// Rebuild the point and color data from the framebuffer
 //
-// @param d   The depth to use
-// @return    The old depth value
+// Every written pixel becomes one point, so the point stream
+// is bounded by the canvas size no matter how much overdraw
+// occurred.
 ///
-float Canvas::setDepth( float d )
+void Canvas::resolveFrame( void )
 {
-    float r = currentDepth;
+    if( !dense || !frameDirty ) {
+        return;
+    }
 
-    currentDepth = d;
-    return( r );
+    dropFramePixels();
+
+    for( int y = 0; y < height; ++y ) {
+        for( int x = 0; x < width; ++x ) {
+            int i = y * width + x;
+            GLubyte rgba[4];
+            memcpy( rgba, &frame[i], sizeof(rgba) );
+            if( rgba[3] == 0 ) {
+                continue;
+            }
+
+            // partly transparent pixels hold premultiplied color
+            float unmul = rgba[3] == 255 ? 1.0f / 255.0f : 1.0f / rgba[3];
+            Color col = {
+                fminf( rgba[0] * unmul, 1.0f ),
+                fminf( rgba[1] * unmul, 1.0f ),
+                fminf( rgba[2] * unmul, 1.0f ),
+                rgba[3] / 255.0f
+            };
+            pushPixel( (float) x, (float) y,
+                       depthPlane.empty() ? -1.0f : depthPlane[i], col );
+        }
+    }
+
+    frameDirty = false;
 }
 
 ///
-// Set the current drawing color
-//
-// @param color   The desired color
-// @return The old color value
+// Drop the framebuffer's pixels from the point and color data,
+// leaving the vertices and colors added directly
 ///
-Color Canvas::setColor( Color color )
+void Canvas::dropFramePixels( void )
 {
-    Color old = currentColor;
-
-    currentColor = color;
-    return( old );
+    points.resize( meshElements * 4 );
+    colors.resize( min( colors.size(), meshColors ) );
+    pixelXY.clear();
+    pixelZ.clear();
+    pixelRGBA.clear();
+    numElements = meshElements;
 }
 
-    /////////////////////////////////////
-    //
-    // Adding things to the Canvas
-    //
-    /////////////////////////////////////
+///
+// Find (or create) the paint entry for a color at the current depth
+//
+// Spans arrive in long runs of the same color, so only the most
+// recently used entry is checked before adding a new one.
+//
+// @param c   The color to use
+// @return    The index of the paint entry
+///
+int Canvas::findPaint( Color c )
+{
+    Paint p = { c, currentDepth };
 
-    /////////////////////////////////////
-    // 2D interface:  Setting pixels
-    /////////////////////////////////////
+    if( !paints.empty() ) {
+        const Paint &last = paints.back();
+        if( last.color.r == p.color.r && last.color.g == p.color.g &&
+            last.color.b == p.color.b && last.color.a == p.color.a &&
+            last.depth == p.depth ) {
+            return( paints.size() - 1 );
+        }
+    }
+
+    paints.push_back( p );
+    return( paints.size() - 1 );
+}
 
 ///
-// Add a pixel using the current drawing color
-//
-// @param p   The pixel to be added
+// Expand any pending spans into the point and color data
 ///
-void Canvas::addPixel( Vertex p )
+void Canvas::expandSpans( void )
 {
-    // we assume that we're working in 2D, and ignore the Z
-    // coordinate that came in with the pixel location
-    Vertex pix = { p.x, p.y, currentDepth };
+    if( spans.empty() ) {
+        return;
+    }
 
-    // ignore the alpha channel value for the current color
-    Color col = { currentColor.r, currentColor.g, currentColor.b, 1.0f };
+    if( format == PIXELS_FLOAT ) {
+        points.reserve( points.size() + 4 * spanPixels );
+        colors.reserve( colors.size() + 4 * spanPixels );
+
+        for( size_t i = 0; i < spans.size(); ++i ) {
+            const Span &s = spans[i];
+            const Paint &p = paints[s.paint];
+            for( int x = s.x0; x < s.x1; ++x ) {
+                points.push_back( (float) x );
+                points.push_back( (float) s.y );
+                points.push_back( p.depth );
+                points.push_back( 1.0f );
+                colors.push_back( p.color.r );
+                colors.push_back( p.color.g );
+                colors.push_back( p.color.b );
+                colors.push_back( p.color.a );
+            }
+        }
+    } else {
+        bool withDepth = format == PIXELS_PACKED_DEPTH;
+        if( numElements == 0 ) {
+            pixelDepth = paints[spans[0].paint].depth;
+        }
+
+        pixelXY.reserve( pixelXY.size() + 2 * spanPixels );
+        pixelRGBA.reserve( pixelRGBA.size() + spanPixels );
+        if( withDepth ) {
+            pixelZ.reserve( pixelZ.size() + spanPixels );
+        }
+
+        // each span's color and depth are packed once, for all of it
+        for( size_t i = 0; i < spans.size(); ++i ) {
+            const Span &s = spans[i];
+            const Paint &p = paints[s.paint];
+            GLuint rgba = toRGBA8( p.color );
+            GLhalf z = toHalf( p.depth );
+            GLshort y = toShort( (float) s.y );
+            for( int x = s.x0; x < s.x1; ++x ) {
+                pixelXY.push_back( toShort( (float) x ) );
+                pixelXY.push_back( y );
+                pixelRGBA.push_back( rgba );
+            }
+            if( withDepth ) {
+                pixelZ.insert( pixelZ.end(), s.x1 - s.x0, z );
+            }
+        }
+    }
 
-    addVertex( pix );
-    addColor( col );
+    numElements += spanPixels;
+
+    spans.clear();
+    paints.clear();
+    spanPixels = 0;
 }
 
 ///
-// Add a pixel using the specified drawing color
+// Add one pixel to the point and color data, in the pixel format
 //
-// @param p     The pixel to be set
-// @param c     The desired color
+// @param x, y  The pixel location
+// @param z     Its depth
+// @param c     Its color
 ///
-void Canvas::addPixelColor( Vertex p, Color c )
+void Canvas::pushPixel( float x, float y, float z, Color c )
 {
-    Vertex pix = { p.x, p.y, currentDepth };
-    Color col = { c.r, c.g, c.b, 1.0f };
+    if( format == PIXELS_FLOAT ) {
+        points.push_back( x );
+        points.push_back( y );
+        points.push_back( z );
+        points.push_back( 1.0f );
+        colors.push_back( c.r );
+        colors.push_back( c.g );
+        colors.push_back( c.b );
+        colors.push_back( c.a );
+    } else {
+        if( numElements == 0 ) {
+            pixelDepth = z;
+        }
+        pixelXY.push_back( toShort( x ) );
+        pixelXY.push_back( toShort( y ) );
+        if( format == PIXELS_PACKED_DEPTH ) {
+            pixelZ.push_back( toHalf( z ) );
+        }
+        pixelRGBA.push_back( toRGBA8( c ) );
+    }
 
-    addVertex( pix );
-    addColor( col );
+    numElements += 1;
 }
 
     /////////////////////////////////////
@@ -186,10 +1191,20 @@ void Canvas::addPixelColor( Vertex p, Color c )
 ///
 void Canvas::addColor( Color c )
 {
+    // the framebuffer's pixels go after this, so they must be rebuilt
+    if( dense ) {
+        dropFramePixels();
+        frameDirty = true;
+    }
+
     colors.push_back( c.r );
     colors.push_back( c.g );
     colors.push_back( c.b );
     colors.push_back( c.a );
+
+    if( dense ) {
+        meshColors = colors.size();
+    }
 }
 
 ///
@@ -199,6 +1214,15 @@ void Canvas::addColor( Color c )
 ///
 void Canvas::addVertex( Vertex v )
 {
+    // keep pending spans ahead of this vertex; a framebuffer's
+    // pixels instead go after it, so they must be rebuilt
+    if( dense ) {
+        dropFramePixels();
+        frameDirty = true;
+    } else {
+        expandSpans();
+    }
+
     points.push_back( v.x );
     points.push_back( v.y );
     points.push_back( v.z );
@@ -207,6 +1231,9 @@ void Canvas::addVertex( Vertex v )
     // here is where we actually count the number of
     // things that have been put into the canvas
     numElements += 1;
+    if( dense ) {
+        meshElements = numElements;
+    }
 }
 
 ///
@@ -290,26 +1317,142 @@ void Canvas::addTextureCoords( TexCoord uv0, TexCoord uv1, TexCoord uv2 )
     addTexCoord( uv2 );
 }
 
+    /////////////////////////////////////
+    // Connectivity
+    /////////////////////////////////////
+
+///
+// Add an element index to the current shape
+//
+// Only needed when vertices are shared between primitives; if no
+// indices are ever added, every vertex is drawn once, in order.
+//
+// @param i   The vertex index to be added
+///
+void Canvas::addIndex( GLuint i )
+{
+    indices.push_back( i );
+}
+
     /////////////////////////////////////
     //
     // Retrieving things from the Canvas
     //
     /////////////////////////////////////
 
+///
+// View of the explicit element indices
+//
+// @return A view of the indices (count 0 if none were added)
+///
+IndexView Canvas::indexData( void )
+{
+    IndexView view = {
+        indices.empty() ? NULL : &indices[0], (int) indices.size()
+    };
+
+    return view;
+}
+
+///
+// View of the pixels, when they are packed
+//
+// @return A view of the pixel data (count 0 if there is none)
+///
+PackedView Canvas::packedData( void )
+{
+    // pending spans become ordinary pixels first
+    resolveFrame();
+    expandSpans();
+
+    bool any = !pixelRGBA.empty();
+    PackedView view = {
+        any ? &pixelXY[0] : NULL,
+        any && !pixelZ.empty() ? &pixelZ[0] : NULL,
+        any ? &pixelRGBA[0] : NULL,
+        pixelDepth,
+        (int) pixelRGBA.size()
+    };
+
+    return view;
+}
+
+///
+// Layout of the vertex, color, normal, and (u,v) data interleaved
+//
+// @return The layout of the records (count 0 if there are none)
+///
+InterleavedLayout Canvas::interleavedLayout( void )
+{
+    // pending spans become ordinary pixels first
+    resolveFrame();
+    expandSpans();
+
+    InterleavedLayout layout = { (int) points.size() / 4, 4, -1, -1, -1 };
+
+    // the location leads, and whatever else there is follows
+    if( !colors.empty() ) {
+        layout.color = layout.stride;
+        layout.stride += 4;
+    }
+    if( !normals.empty() ) {
+        layout.normal = layout.stride;
+        layout.stride += 3;
+    }
+    if( !uv.empty() ) {
+        layout.uv = layout.stride;
+        layout.stride += 2;
+    }
+
+    return layout;
+}
+
+///
+// Write the vertex, color, normal, and (u,v) data interleaved
+//
+// @param dst   Room for count * stride floats
+///
+void Canvas::interleaveInto( float *dst )
+{
+    InterleavedLayout layout = interleavedLayout();
+    int count = layout.count, stride = layout.stride;
+
+    // a record at a time, so that the records are written in one pass
+    for( int i = 0; i < count; ++i, dst += stride ) {
+        interleave<4>( points, i, dst );
+        if( layout.color >= 0 ) {
+            interleave<4>( colors, i, dst + layout.color );
+        }
+        if( layout.normal >= 0 ) {
+            interleave<3>( normals, i, dst + layout.normal );
+        }
+        if( layout.uv >= 0 ) {
+            interleave<2>( uv, i, dst + layout.uv );
+        }
+    }
+}
+
 ///
 // Retrieve the array of element data from this Canvas
 //
+// This is the explicit index list if there is one, and an
+// identity mapping (0, 1, 2, ...) otherwise.
+//
 // @return A pointer to a dynamic array of data, or NULL
 ///
 GLuint *Canvas::getElements( void )
 {
+    // pending spans become ordinary pixels first
+    resolveFrame();
+    expandSpans();
+
     // delete the old element array if we have one
     if( elemArray ) {
         delete [] elemArray;
         elemArray = 0;
     }
 
-    int n = numElements;
+    int n = indices.empty() ? numElements : indices.size();
 
     if( n > 0 ) {
         // create and fill a new element array
@@ -319,7 +1462,7 @@ GLuint *Canvas::getElements( void )
             exit( 1 );
         }
         for( int i = 0; i < n; i++ ) {
-            elemArray[i] = i;
+            elemArray[i] = indices.empty() ? i : indices[i];
         }
     }
 
@@ -327,93 +1470,110 @@ GLuint *Canvas::getElements( void )
 }
 
 ///
-// Retrieve the array of vertex data from this Canvas
+// Build a view of one of the data vectors
 //
-// @return A pointer to a dynamic array of data, or NULL
+// @param v   The vector to view
+// @return    A view of its contents
 ///
-float *Canvas::getVertices( void )
+FloatView Canvas::makeView( const vector<float> &v )
 {
-    // delete the old point array if we have one
-    if( pointArray ) {
-        delete [] pointArray;
-        pointArray = 0;
-    }
+    FloatView view = { v.empty() ? NULL : &v[0], (int) v.size() };
 
-    int n = points.size();
+    return view;
+}
 
-    if( n > 0 ) {
-        // create and fill a new point array
-        pointArray = new float[ n ];
-        if( pointArray == 0 ) {
-            cerr << "point allocation failure" << endl;
+///
+// Replace a legacy copy array with a fresh copy of a view
+//
+// @param view    The data to copy
+// @param array   The copy array to replace
+// @param what    Name of the data, for error messages
+// @return        The new array, or NULL
+///
+float *Canvas::copyView( FloatView view, float *&array, const char *what )
+{
+    // delete the old array if we have one
+    if( array ) {
+        delete [] array;
+        array = 0;
+    }
+
+    if( view.count > 0 ) {
+        // create and fill a new array
+        array = new float[ view.count ];
+        if( array == 0 ) {
+            cerr << what << " allocation failure" << endl;
             exit( 1 );
         }
-        for( int i = 0; i < n; i++ ) {
-            pointArray[i] = points[i];
-        }
+        memcpy( array, view.data, view.count * sizeof(float) );
     }
 
-    return pointArray;
+    return array;
 }
 
 ///
-// Retrieve the array of normal data from this Canvas
+// Views of the vertex, color, normal, and (u,v) data
 //
-// @return A pointer to a dynamic array of data, or NULL
+// Unlike the get*() functions, these do not copy; they
+// expose the Canvas' storage directly.
+//
+// @return A view of the data (count 0 if there is none)
 ///
-float *Canvas::getNormals( void )
+FloatView Canvas::vertexData( void )
 {
-    // delete the old normal array if we have one
-    if( normalArray ) {
-        delete [] normalArray;
-        normalArray = 0;
-    }
+    // pending spans become ordinary pixels first
+    resolveFrame();
+    expandSpans();
 
-    int n = normals.size();
+    return makeView( points );
+}
 
-    if( n > 0 ) {
-        // create and fill a new normal array
-        normalArray = new float[ n ];
-        if( normalArray == 0 ) {
-            cerr << "normal allocation failure" << endl;
-            exit( 1 );
-        }
-        for( int i = 0; i < n; i++ ) {
-            normalArray[i] = normals[i];
-        }
-    }
+FloatView Canvas::colorData( void )
+{
+    resolveFrame();
+    expandSpans();
+
+    return makeView( colors );
+}
+
+FloatView Canvas::normalData( void )
+{
+    return makeView( normals );
+}
 
-    return normalArray;
+FloatView Canvas::uvData( void )
+{
+    return makeView( uv );
 }
 
 ///
-// Retrieve the array of texture coordinate data from this Canvas
+// Retrieve the array of vertex data from this Canvas
 //
 // @return A pointer to a dynamic array of data, or NULL
 ///
-float *Canvas::getUV( void )
+float *Canvas::getVertices( void )
 {
-    // delete the old texture coordinate array if we have one
-    if( uvArray ) {
-        delete [] uvArray;
-        uvArray = 0;
-    }
-
-    int n = uv.size();
+    return copyView( vertexData(), pointArray, "point" );
+}
 
-    if( n > 0 ) {
-        // create and fill a new texture coordinate array
-        uvArray = new float[ n ];
-        if( uvArray == 0 ) {
-            cerr << "uv allocation failure" << endl;
-            exit( 1 );
-        }
-        for( int i = 0; i < n; i++ ) {
-            uvArray[i] = uv[i];
-        }
-    }
+///
+// Retrieve the array of normal data from this Canvas
+//
+// @return A pointer to a dynamic array of data, or NULL
+///
+float *Canvas::getNormals( void )
+{
+    return copyView( normalData(), normalArray, "normal" );
+}
 
-    return uvArray;
+///
+// Retrieve the array of texture coordinate data from this Canvas
+//
+// @return A pointer to a dynamic array of data, or NULL
+///
+float *Canvas::getUV( void )
+{
+    return copyView( uvData(), uvArray, "uv" );
 }
 
 ///
@@ -423,35 +1583,63 @@ float *Canvas::getUV( void )
 ///
 float *Canvas::getColors( void )
 {
-    // delete the old color array if we have one
-    if( colorArray ) {
-        delete [] colorArray;
-        colorArray = 0;
-    }
+    return copyView( colorData(), colorArray, "color" );
+}
+
+///
+// Retrieve the vertex count from this Canvas
+//
+// @return The number of vertices in the canvas
+///
+int Canvas::numVertices( void )
+{
+    resolveFrame();
+    return numElements + spanPixels;
+}
 
-    int n = colors.size();
+///
+// Retrieve the number of spans not yet expanded into pixels
+//
+// @return The number of pending spans
+///
+int Canvas::numSpans( void )
+{
+    return spans.size();
+}
 
-    if( n > 0 ) {
-        // create and fill a new color array
-        colorArray = new float[ n ];
-        if( colorArray == 0 ) {
-            cerr << "color allocation failure" << endl;
-            exit( 1 );
-        }
-        for( int i = 0; i < n; i++ ) {
-            colorArray[i] = colors[i];
-        }
+///
+// Retrieve the framebuffer contents from this Canvas
+//
+// The data is width x height RGBA8 pixels, bottom row first,
+// ready to be handed to glTexImage2D().
+//
+// @return A pointer to the pixel data, or NULL
+///
+const GLubyte *Canvas::getPixels( void )
+{
+    if( !dense || frame.empty() ) {
+        return NULL;
     }
 
-    return colorArray;
+    return (const GLubyte *) &frame[0];
 }
 
 ///
-// Retrieve the vertex count from this Canvas
+// Retrieve the canvas width
 //
-// @return The number of vertices in the canvas
+// @return The width of the canvas
 ///
-int Canvas::numVertices( void )
+int Canvas::getWidth( void )
+{
+    return width;
+}
+
+///
+// Retrieve the canvas height
+//
+// @return The height of the canvas
+///
+int Canvas::getHeight( void )
 {
-    return numElements;
+    return height;
 }
@@ -13,16 +13,42 @@
 //
 //  This module provides two basic interfaces:  a pixel interface for
 //  simple 2D drawings, and a vertex interface for 3D drawings.  The pixel
-//  interface consists of two functions:
+//  interface consists of four functions:
 //
 //      addPixel()          adds a pixel and the current drawing color
 //      addPixelColor()     adds a pixel using the specified color
+//      addSpan()           adds a run of pixels using the current color
+//      addSpanColor()      adds a run of pixels using the specified color
 //
 //  These functions assume that every pixel should have a color, and
 //  ensure that both position and color data are added to the canvas
 //  when each is called.  As we're working in 2D, only the X and Y
 //  components of the pixel location are used, and the alpha channel
-//  of the color is forced to 1.0.
+//  of the color is forced to 1.0.  The one exception is addSpanBlend(),
+//  which keeps the alpha channel so that partly covered pixels (e.g.,
+//  anti-aliased polygon edges) can be blended over what is already
+//  there.
+//
+//  Spans are stored as compact (y, x0, x1, paint) records, and are
+//  only expanded into individual pixels when the vertex data is
+//  retrieved (or when a vertex is added after them, to preserve
+//  drawing order).
+//
+//  Alternatively, the pixel interface can be backed by a dense
+//  width x height RGBA8 framebuffer (see useFramebuffer()), in which
+//  case pixels and spans are written in place and overdraw replaces
+//  earlier pixels instead of adding more of them.  The framebuffer
+//  may also carry a depth plane, which is tested (less-or-equal, as
+//  with the GL depth test) against the setDepth() value.  Vertices
+//  added to such a canvas are kept apart from its pixels, which
+//  always follow them in the vertex data.
+//
+//  The pixels handed to the GL can be kept as four floats of position
+//  and four of color each (the default), or packed (see
+//  setPixelFormat()):  two shorts of position and an RGBA8 color,
+//  optionally with a half-float depth, for a quarter of the memory
+//  and upload bandwidth.  Either way, overdrawn pixels can be dropped
+//  before they are handed over (see compactPixels()).
 //
 //  For 3D drawings, vertices, colors, surface normals, and texture
 //  coordinates are added separately.  Vertices are counted; the module
@@ -31,7 +57,8 @@
 //  will be returned when each type of data is requested by the
 //  application.  It is the application's responsibility to ensure that
 //  all the relevant data has been added to the canvas in the proper
-//  sequence.
+//  sequence.  They can also be written out interleaved (see
+//  interleaveInto()), as one stream of per-vertex records.
 ///
 
 #ifndef _CANVAS_H_
@@ -47,11 +74,57 @@
 
 #include <GLFW/glfw3.h>
 
+#include <stdint.h>
+
 #include "Types.h"
 
 using namespace std;
 
 #include <vector>
+#include <atomic>
+
+///
+// Read-only view of a block of Canvas data
+//
+// 'data' points directly at the Canvas' own storage, and stays valid
+// until the next call which adds to or clears the Canvas.
+///
+
+typedef struct st_floatview {
+    const float *data;      // first value (NULL if count is 0)
+    int count;              // number of floats
+} FloatView;
+
+typedef struct st_indexview {
+    const GLuint *data;     // first index (NULL if count is 0)
+    int count;              // number of indices
+} IndexView;
+
+typedef struct st_packedview {
+    const GLshort *xy;      // x and y of each pixel (NULL if count is 0)
+    const GLhalf *z;        // depth of each pixel (NULL if not kept)
+    const GLuint *rgba;     // color of each pixel, as RGBA8
+    float depth;            // depth of every pixel, when z is NULL
+    int count;              // number of pixels
+} PackedView;
+
+typedef struct st_interleavedlayout {
+    int count;              // number of vertices
+    int stride;             // floats per vertex
+    int color;              // offsets within a vertex, in floats, of
+    int normal;             //   its color, normal, and (u,v) data
+    int uv;                 //   (-1 for data the canvas doesn't have)
+} InterleavedLayout;
+
+///
+// Formats for the pixels of the pixel interface
+///
+
+typedef enum sPixelFormat {
+    PIXELS_FLOAT,           // XYZW and RGBA as floats (32 bytes)
+    PIXELS_PACKED,          // XY as shorts, and RGBA8 (8 bytes)
+    PIXELS_PACKED_DEPTH     // as above, plus Z as a half float (10 bytes)
+} PixelFormat;
 
 ///
 // Simple canvas class that allows for pixel-by-pixel rendering.
@@ -89,6 +162,182 @@ class Canvas {
     int numElements;
     GLuint *elemArray;
 
+    // explicit connectivity (empty unless vertices are shared)
+    vector<GLuint> indices;
+
+    // format of the pixels, and their data when packed (without
+    // depths, the first pixel's depth stands for all of them)
+    PixelFormat format;
+    vector<GLshort> pixelXY;
+    vector<GLhalf> pixelZ;
+    vector<GLuint> pixelRGBA;
+    float pixelDepth;
+
+    ///
+    // Add one pixel to the point and color data, in the pixel format
+    //
+    // @param x, y  The pixel location
+    // @param z     Its depth
+    // @param c     Its color
+    ///
+    void pushPixel( float x, float y, float z, Color c );
+
+    // per-location and per-pixel scratch for compactPixels()
+    vector<int> lastOpaque;
+    vector<float> depthSoFar;
+    vector<int> pixelLoc;
+
+    ///
+    // Find one pixel of the pixel data
+    //
+    // @param i        The pixel
+    // @param z        Its depth (out)
+    // @param opaque   Does it hide what is beneath it? (out)
+    // @return         Its location (y * width + x), or -1 if it is
+    //                 off the canvas
+    ///
+    int pixelAt( int i, float &z, bool &opaque );
+
+    ///
+    // Copy one pixel of the pixel data over another
+    //
+    // @param from   The pixel to copy
+    // @param to     The pixel to replace
+    ///
+    void movePixel( int from, int to );
+
+    ///
+    // span-related data
+    ///
+
+    // a horizontal run of pixels x0 <= x < x1 on scanline y
+    struct Span {
+        int y;
+        int x0, x1;
+        int paint;      // index into 'paints'
+    };
+
+    // color and depth shared by a group of spans
+    struct Paint {
+        Color color;
+        float depth;
+    };
+
+    // spans not yet expanded into pixels
+    vector<Span> spans;
+
+    // distinct paints used by the pending spans
+    vector<Paint> paints;
+
+    // number of pixels covered by the pending spans
+    int spanPixels;
+
+    ///
+    // Find (or create) the paint entry for a color at the current depth
+    //
+    // @param c   The color to use
+    // @return    The index of the paint entry
+    ///
+    int findPaint( Color c );
+
+    ///
+    // Expand any pending spans into the point and color data
+    ///
+    void expandSpans( void );
+
+    ///
+    // Build a view of one of the data vectors
+    //
+    // @param v   The vector to view
+    // @return    A view of its contents
+    ///
+    FloatView makeView( const vector<float> &v );
+
+    ///
+    // Replace a legacy copy array with a fresh copy of a view
+    //
+    // @param view    The data to copy
+    // @param array   The copy array to replace
+    // @param what    Name of the data, for error messages
+    // @return        The new array, or NULL
+    ///
+    float *copyView( FloatView view, float *&array, const char *what );
+
+    ///
+    // dense framebuffer data
+    ///
+
+    // are pixels being written into the framebuffer?
+    bool dense;
+
+    // has the framebuffer changed since it was last resolved?
+    // (atomic, as disjoint regions may be written by several threads)
+    atomic<bool> frameDirty;
+
+    // vertices and colors added directly, which lead the point and
+    // color data; the framebuffer's pixels follow them
+    int meshElements;
+    size_t meshColors;
+
+    ///
+    // Drop the framebuffer's pixels from the point and color data,
+    // leaving the vertices and colors added directly
+    ///
+    void dropFramePixels( void );
+
+    // RGBA8 pixels, row-major from the bottom row (alpha 0 = unwritten);
+    // blended pixels are stored with their color premultiplied by alpha
+    vector<GLuint> frame;
+
+    // depth plane (empty if not in use)
+    vector<float> depthPlane;
+
+    ///
+    // Write a run of pixels into the framebuffer
+    //
+    // @param y     The scanline
+    // @param x0    The first pixel in the run
+    // @param x1    One past the last pixel in the run
+    // @param c     The desired color
+    ///
+    void writeSpan( int y, int x0, int x1, Color c );
+
+    ///
+    // Blend a run of pixels into the framebuffer
+    //
+    // @param y     The scanline
+    // @param x0    The first pixel in the run
+    // @param x1    One past the last pixel in the run
+    // @param c     The desired color, including its alpha
+    ///
+    void blendSpan( int y, int x0, int x1, Color c );
+
+    ///
+    // Write a run of linearly shaded pixels into the framebuffer
+    //
+    // @param y     The scanline
+    // @param x0    The first pixel in the run
+    // @param x1    One past the last pixel in the run
+    // @param c     The color of pixel x0
+    // @param dc    The change in color from one pixel to the next
+    ///
+    void shadeSpan( int y, int x0, int x1, Color c, Color dc );
+
+    ///
+    // Copy a run of ready-made pixels into the framebuffer
+    //
+    // @param y     The scanline
+    // @param x0    The first pixel in the run
+    // @param x1    One past the last pixel in the run
+    // @param pix   The pixels, as RGBA8
+    ///
+    void copySpan( int y, int x0, int x1, const uint32_t *pix );
+
+    ///
+    // Rebuild the point and color data from the framebuffer
+    ///
+    void resolveFrame( void );
+
     ///
     // other Canvas defaults
     ///
@@ -122,6 +371,17 @@ public:
     ///
     void clear( void );
 
+    ///
+    // Clear one rectangle of a dense framebuffer
+    //
+    // The pixels become unwritten again, and their depth (if there
+    // is a depth plane) goes back to the far plane.  The rectangle
+    // is clipped to the canvas.  Does nothing without a framebuffer.
+    //
+    // @param r   The rectangle to clear
+    ///
+    void clearRect( Rect r );
+
     ///
     // Set the pixel Z coordinate
     //
@@ -138,6 +398,94 @@ public:
     ///
     Color setColor( Color color );
 
+    ///
+    // Get the current drawing color
+    //
+    // @return  The current color
+    ///
+    Color getColor( void );
+
+    ///
+    // Back the pixel interface with a dense framebuffer
+    //
+    // Any point data already in the canvas (pixels or vertices) is
+    // discarded.  Vertices added afterwards are kept, ahead of the
+    // framebuffer's pixels.
+    //
+    // @param useDepth   also keep a depth plane
+    ///
+    void useFramebuffer( bool useDepth );
+
+    ///
+    // Is the pixel interface backed by a dense framebuffer?
+    //
+    // @return true if it is
+    ///
+    bool hasFramebuffer( void );
+
+    ///
+    // Choose the format the pixel interface keeps its pixels in
+    //
+    // With PIXELS_FLOAT (the default), each pixel is a vertex of
+    // four floats and a color of four more, available through
+    // vertexData() and colorData().  The packed formats keep two
+    // shorts of position (rounded to the nearest pixel) and an RGBA8
+    // color instead, available only through packedData();
+    // PIXELS_PACKED_DEPTH also keeps each pixel's depth as a half
+    // float (a vertex attribute format which needs GL 3.0), while
+    // with PIXELS_PACKED every pixel gets the depth of the first.
+    //
+    // The packed formats are for the pixel interface only; a canvas
+    // using them should not be given vertices.  Any pixel data
+    // already in the canvas is discarded.
+    //
+    // @param f   The format to use
+    ///
+    void setPixelFormat( PixelFormat f );
+
+    ///
+    // The format pixels are kept in
+    //
+    // @return The format
+    ///
+    PixelFormat getPixelFormat( void );
+
+    ///
+    // Drop the pixels which would not show on screen
+    //
+    // Every pixel drawn over a location adds to the pixel data, so
+    // overdrawn locations appear many times.  This keeps, for each
+    // location, only the pixels the GL would still see:  the last
+    // opaque pixel, and any blended (alpha < 1) pixels after it.
+    // Pixels with a depth outside [-1, 1], which the GL clips away,
+    // are dropped and hide nothing.  With 'depthTest', the rest are
+    // first put through the GL's depth test (less-or-equal, with 1.0
+    // as the cleared depth), and those which would fail it are
+    // dropped too.  Either way, the image the GL draws from the
+    // remaining pixels is the same, and they stay in drawing order.
+    //
+    // Other pixels off the canvas are left alone.  Does nothing with a
+    // framebuffer (it already holds one pixel per location), or to a
+    // canvas holding element indices or anything but pixels.
+    //
+    // @param depthTest   Will the GL depth test the pixels?
+    // @return            The number of pixels dropped
+    ///
+    int compactPixels( bool depthTest );
+
+    ///
+    // Take a range of pixels back out of the pixel data
+    //
+    // The pixels after them move down to take their place.  Does
+    // nothing with a framebuffer, or to a canvas holding element
+    // indices or anything but pixels.
+    //
+    // @param first   The first pixel to remove
+    // @param last    One past the last pixel to remove
+    // @return        The number of pixels removed
+    ///
+    int removePixels( int first, int last );
+
     /////////////////////////////////////
     //
     // Adding things to the Canvas
@@ -163,6 +511,70 @@ public:
     ///
     void addPixelColor( Vertex v, Color c );
 
+    ///
+    // Add a run of pixels using the current drawing color
+    //
+    // @param y     The scanline
+    // @param x0    The first pixel in the run
+    // @param x1    One past the last pixel in the run
+    ///
+    void addSpan( int y, int x0, int x1 );
+
+    ///
+    // Add a run of pixels using the specified drawing color
+    //
+    // @param y     The scanline
+    // @param x0    The first pixel in the run
+    // @param x1    One past the last pixel in the run
+    // @param c     The desired color
+    ///
+    void addSpanColor( int y, int x0, int x1, Color c );
+
+    ///
+    // Add a run of pixels to be blended over what is already there
+    //
+    // Unlike the other pixel functions, this keeps the alpha channel
+    // of the color.  In a dense framebuffer the pixels are blended
+    // in place ("source over"); with a depth plane, only pixels which
+    // pass the depth test are blended, and they take the current
+    // depth, as the GL's blended fragments do.  Otherwise they are
+    // added as points, and blending is left to the GL.
+    //
+    // @param y     The scanline
+    // @param x0    The first pixel in the run
+    // @param x1    One past the last pixel in the run
+    // @param c     The desired color, including its alpha
+    ///
+    void addSpanBlend( int y, int x0, int x1, Color c );
+
+    ///
+    // Add a run of pixels whose color changes linearly along it
+    //
+    // Pixel x0 + i gets color c + i * dc.  As with the other pixel
+    // functions, the alpha channel is forced to 1.0.
+    //
+    // @param y     The scanline
+    // @param x0    The first pixel in the run
+    // @param x1    One past the last pixel in the run
+    // @param c     The color of pixel x0
+    // @param dc    The change in color from one pixel to the next
+    ///
+    void addSpanShaded( int y, int x0, int x1, Color c, Color dc );
+
+    ///
+    // Add a run of pixels, each with its own color
+    //
+    // The colors are packed as four bytes R, G, B, A, the same
+    // layout as getPixels(); as with the other pixel functions,
+    // the alpha channel is forced to 1.0.
+    //
+    // @param y     The scanline
+    // @param x0    The first pixel in the run
+    // @param x1    One past the last pixel in the run
+    // @param pix   The x1 - x0 pixel colors
+    ///
+    void addSpanPixels( int y, int x0, int x1, const uint32_t *pix );
+
     /////////////////////////////////////
     // Individual things (vertices, etc.)
     /////////////////////////////////////
@@ -232,15 +644,82 @@ public:
     ///
     void addTextureCoords( TexCoord uv0, TexCoord uv1, TexCoord uv2 );
 
+    /////////////////////////////////////
+    // Connectivity
+    /////////////////////////////////////
+
+    ///
+    // Add an element index to the current shape
+    //
+    // Only needed when vertices are shared between primitives; if no
+    // indices are ever added, every vertex is drawn once, in order.
+    //
+    // @param i   The vertex index to be added
+    ///
+    void addIndex( GLuint i );
+
     /////////////////////////////////////
     //
     // Retrieving things from the Canvas
     //
     /////////////////////////////////////
 
+    ///
+    // Views of the vertex, color, normal, and (u,v) data
+    //
+    // Unlike the get*() functions below, these do not copy; they
+    // expose the Canvas' storage directly.
+    //
+    // @return A view of the data (count 0 if there is none)
+    ///
+    FloatView vertexData( void );
+    FloatView colorData( void );
+    FloatView normalData( void );
+    FloatView uvData( void );
+
+    ///
+    // View of the explicit element indices
+    //
+    // @return A view of the indices (count 0 if none were added)
+    ///
+    IndexView indexData( void );
+
+    ///
+    // View of the pixels, when they are packed
+    //
+    // @return A view of the pixel data (count 0 if there is none)
+    ///
+    PackedView packedData( void );
+
+    ///
+    // Layout of the vertex, color, normal, and (u,v) data interleaved
+    //
+    // Each vertex is one record of its XYZW location followed by
+    // whichever of its RGBA color, XYZ normal, and UV coordinates
+    // the canvas has.  Packed pixels (see setPixelFormat()) are not
+    // included.
+    //
+    // @return The layout of the records (count 0 if there are none)
+    ///
+    InterleavedLayout interleavedLayout( void );
+
+    ///
+    // Write the vertex, color, normal, and (u,v) data interleaved
+    //
+    // The records are laid out as interleavedLayout() describes.
+    // The canvas keeps no copy of them:  they go straight to 'dst',
+    // which can be a mapped buffer object.
+    //
+    // @param dst   Room for count * stride floats
+    ///
+    void interleaveInto( float *dst );
+
     ///
     // Retrieve the array of element data from this Canvas
     //
+    // This is the explicit index list if there is one, and an
+    // identity mapping (0, 1, 2, ...) otherwise.
+    //
     // @return A pointer to a dynamic array of data, or NULL
     ///
     GLuint *getElements( void );
@@ -280,6 +759,32 @@ public:
     ///
     int numVertices( void );
 
+    ///
+    // Retrieve the number of spans not yet expanded into pixels
+    //
+    // @return The number of pending spans
+    ///
+    int numSpans( void );
+
+    ///
+    // Retrieve the framebuffer contents from this Canvas
+    //
+    // The data is width x height RGBA8 pixels, bottom row first,
+    // ready to be handed to glTexImage2D().  Pixels written with
+    // addSpanBlend() have their color premultiplied by their alpha.
+    //
+    // @return A pointer to the pixel data, or NULL
+    ///
+    const GLubyte *getPixels( void );
+
+    ///
+    // Retrieve the canvas dimensions
+    //
+    // @return The width (or height) of the canvas
+    ///
+    int getWidth( void );
+    int getHeight( void );
+
 };
 
 #endif
@@ -0,0 +1,159 @@
+///
+//  Path.cpp
+//
+//  Outline made of lines and quadratic and cubic Bezier curves.
+///
+
+#include <algorithm>
+
+#include "Path.h"
+
+using namespace std;
+
+///
+// Constructor (the path starts out empty)
+///
+Path::Path( void ) : xmin(0.0f), ymin(0.0f), xmax(0.0f), ymax(0.0f)
+{
+}
+
+///
+// Record a point
+///
+void Path::addPoint( float x, float y )
+{
+    if( coords.empty() ) {
+        xmin = xmax = x;
+        ymin = ymax = y;
+    } else {
+        xmin = min( xmin, x );
+        xmax = max( xmax, x );
+        ymin = min( ymin, y );
+        ymax = max( ymax, y );
+    }
+
+    coords.push_back( x );
+    coords.push_back( y );
+}
+
+///
+// Start a subpath at (0,0) if none has been started
+///
+void Path::ensureStart( void )
+{
+    if( verbs.empty() ) {
+        moveTo( 0.0f, 0.0f );
+    }
+}
+
+///
+// Start a new subpath
+//
+// @param x, y - its first point
+///
+void Path::moveTo( float x, float y )
+{
+    verbs.push_back( PATH_MOVE );
+    addPoint( x, y );
+}
+
+///
+// Add a straight line from the current point
+//
+// @param x, y - the end point
+///
+void Path::lineTo( float x, float y )
+{
+    ensureStart();
+    verbs.push_back( PATH_LINE );
+    addPoint( x, y );
+}
+
+///
+// Add a quadratic Bezier curve from the current point
+//
+// @param cx, cy - the control point
+// @param x, y   - the end point
+///
+void Path::quadTo( float cx, float cy, float x, float y )
+{
+    ensureStart();
+    verbs.push_back( PATH_QUAD );
+    addPoint( cx, cy );
+    addPoint( x, y );
+}
+
+///
+// Add a cubic Bezier curve from the current point
+//
+// @param c1x, c1y - the first control point
+// @param c2x, c2y - the second control point
+// @param x, y     - the end point
+///
+void Path::cubicTo( float c1x, float c1y, float c2x, float c2y,
+                    float x, float y )
+{
+    ensureStart();
+    verbs.push_back( PATH_CUBIC );
+    addPoint( c1x, c1y );
+    addPoint( c2x, c2y );
+    addPoint( x, y );
+}
+
+///
+// Close the current subpath
+///
+void Path::close( void )
+{
+    if( !verbs.empty() ) {
+        verbs.push_back( PATH_CLOSE );
+    }
+}
+
+///
+// Empty the path, keeping its memory
+///
+void Path::clear( void )
+{
+    verbs.clear();
+    coords.clear();
+    xmin = ymin = xmax = ymax = 0.0f;
+}
+
+///
+// Is the path empty?
+//
+// @return true if it has no segments
+///
+bool Path::isEmpty( void ) const
+{
+    return verbs.empty();
+}
+
+///
+// The recorded segments, and their points
+///
+
+const vector<PathVerb> &Path::getVerbs( void ) const
+{
+    return verbs;
+}
+
+const vector<float> &Path::getCoords( void ) const
+{
+    return coords;
+}
+
+///
+// Bounding box of every point recorded, control points included
+//
+// @param x0, y0 - lower left corner (out)
+// @param x1, y1 - upper right corner (out)
+///
+void Path::getBounds( float &x0, float &y0, float &x1, float &y1 ) const
+{
+    x0 = xmin;
+    y0 = ymin;
+    x1 = xmax;
+    y1 = ymax;
+}
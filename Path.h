@@ -0,0 +1,133 @@
+///
+//  Path.h
+//
+//  Outline made of lines and quadratic and cubic Bezier curves.
+//
+//  A Path only records what it is given, compactly:  one verb per
+//  segment, and the points each verb needs.  Curves are flattened
+//  into lines only when the path is drawn (see Rasterizer::drawPath()),
+//  at the resolution the screen calls for.
+//
+//  Every subpath is filled as if closed; close() just makes that
+//  explicit.  clear() keeps the memory, so one Path can be rebuilt
+//  over and over without allocating.
+///
+
+#ifndef _PATH_H_
+#define _PATH_H_
+
+#include <vector>
+
+///
+// Path segments
+///
+
+typedef enum sPathVerb {
+    PATH_MOVE,          // start a subpath at a point
+    PATH_LINE,          // straight line to a point
+    PATH_QUAD,          // quadratic curve:  control point, end point
+    PATH_CUBIC,         // cubic curve:  two control points, end point
+    PATH_CLOSE          // back to the start of the subpath
+} PathVerb;
+
+class Path {
+
+    // the segments, in order
+    std::vector<PathVerb> verbs;
+
+    // the points the segments need, as x,y pairs
+    std::vector<float> coords;
+
+    // bounding box of every point (control points included), and
+    // so of the whole outline
+    float xmin, ymin, xmax, ymax;
+
+    ///
+    // Record a point
+    ///
+    void addPoint( float x, float y );
+
+    ///
+    // Start a subpath at (0,0) if none has been started
+    ///
+    void ensureStart( void );
+
+public:
+
+    ///
+    // Constructor (the path starts out empty)
+    ///
+    Path( void );
+
+    ///
+    // Start a new subpath
+    //
+    // @param x, y - its first point
+    ///
+    void moveTo( float x, float y );
+
+    ///
+    // Add a straight line from the current point
+    //
+    // A path which doesn't start with moveTo() starts at (0,0).
+    //
+    // @param x, y - the end point
+    ///
+    void lineTo( float x, float y );
+
+    ///
+    // Add a quadratic Bezier curve from the current point
+    //
+    // @param cx, cy - the control point
+    // @param x, y   - the end point
+    ///
+    void quadTo( float cx, float cy, float x, float y );
+
+    ///
+    // Add a cubic Bezier curve from the current point
+    //
+    // @param c1x, c1y - the first control point
+    // @param c2x, c2y - the second control point
+    // @param x, y     - the end point
+    ///
+    void cubicTo( float c1x, float c1y, float c2x, float c2y,
+                  float x, float y );
+
+    ///
+    // Close the current subpath; the next segment starts from its
+    // first point
+    ///
+    void close( void );
+
+    ///
+    // Empty the path, keeping its memory
+    ///
+    void clear( void );
+
+    ///
+    // Is the path empty?
+    //
+    // @return true if it has no segments
+    ///
+    bool isEmpty( void ) const;
+
+    ///
+    // The recorded segments, and their points
+    //
+    // PATH_MOVE and PATH_LINE take one point each, PATH_QUAD two,
+    // PATH_CUBIC three, and PATH_CLOSE none.
+    ///
+    const std::vector<PathVerb> &getVerbs( void ) const;
+    const std::vector<float> &getCoords( void ) const;
+
+    ///
+    // Bounding box of every point recorded, control points included
+    //
+    // @param x0, y0 - lower left corner (out)
+    // @param x1, y1 - upper right corner (out)
+    ///
+    void getBounds( float &x0, float &y0, float &x1, float &y1 ) const;
+
+};
+
+#endif
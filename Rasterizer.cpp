@@ -10,153 +10,2699 @@
 //  Contributor:  YOUR_NAME_HERE
 ///
 
-#include <list>
+#include <cmath>
+#include <climits>
 #include <algorithm>
 #include <iostream>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "Types.h"
 #include "Rasterizer.h"
 #include "Canvas.h"
 
-#define INF 99999;
+using namespace std;
+
+///
+// Constructor
+//
+// @param n number of scanlines
+// @param C The Canvas to use
+///
+Rasterizer::Rasterizer( int n, Canvas &canvas ) :
+    n_scanlines(n), shadeMode(SHADE_COLOR), texture(0), yLo(0), yHi(0),
+    useFill(false),
+    fillRule(FILL_EVEN_ODD), antialias(false), tolerance(0.25f), cache(0),
+    recording(false),
+    occlude(false), maskWords(0), depthTest(false), tilesX(0),
+    rasterized(0), written(0), C(canvas)
+{
+    // every bucket starts out empty; the sweep empties each
+    // bucket again as it consumes it
+    buckets.assign( n > 0 ? n : 0, -1 );
+
+    resetClip();
+}
+
+///
+// Restrict drawing to a rectangle
+//
+// The rectangle is always limited to the scanline range and
+// the width of the canvas.
+//
+// @param x0 - leftmost pixel column
+// @param y0 - lowest scanline
+// @param x1 - one past the rightmost pixel column
+// @param y1 - one past the highest scanline
+///
+void Rasterizer::setClip( int x0, int y0, int x1, int y1 )
+{
+    clipX0 = max( x0, 0 );
+    clipX1 = min( x1, C.getWidth() );
+    clipY0 = max( y0, 0 );
+    clipY1 = min( y1, n_scanlines );
+}
+
+///
+// Remove the clipping rectangle
+///
+void Rasterizer::resetClip( void )
+{
+    setClip( 0, 0, C.getWidth(), n_scanlines );
+}
+
+///
+// Choose the fill rule for polygons drawn from now on
+//
+// @param rule - FILL_EVEN_ODD or FILL_NONZERO
+///
+void Rasterizer::setFillRule( FillRule rule )
+{
+    fillRule = rule;
+}
+
+///
+// The fill rule in use
+//
+// @return the fill rule
+///
+FillRule Rasterizer::getFillRule( void )
+{
+    return fillRule;
+}
+
+///
+// Turn anti-aliasing on or off for polygons drawn from now on
+//
+// @param on - true to anti-alias
+///
+void Rasterizer::setAntialias( bool on )
+{
+    antialias = on;
+}
+
+///
+// Is anti-aliasing on?
+//
+// @return true if it is
+///
+bool Rasterizer::getAntialias( void )
+{
+    return antialias;
+}
+
+///
+// Set how far a flattened path may stray from its true curves
+//
+// @param t - the tolerance, in pixels (at least 1/64)
+///
+void Rasterizer::setTolerance( float t )
+{
+    tolerance = max( t, 1.0f / 64.0f );
+}
+
+///
+// The path flattening tolerance in use
+//
+// @return the tolerance, in pixels
+///
+float Rasterizer::getTolerance( void )
+{
+    return tolerance;
+}
+
+///
+// Use a cache of rasterized polygons in drawPolygon()
+//
+// @param c - the cache, or NULL for none
+///
+void Rasterizer::setSpanCache( SpanCache *c )
+{
+    cache = c;
+}
+
+///
+// The cache of rasterized polygons in use
+//
+// @return the cache, or NULL if there is none
+///
+SpanCache *Rasterizer::getSpanCache( void )
+{
+    return cache;
+}
+
+///
+// Turn front-to-back drawing on or off
+//
+// @param on - true to draw front to back
+///
+void Rasterizer::setOcclusion( bool on )
+{
+    occlude = on;
+    if( on ) {
+        clearOcclusion();
+    }
+}
+
+///
+// Is front-to-back drawing on?
+//
+// @return true if it is
+///
+bool Rasterizer::getOcclusion( void )
+{
+    return occlude;
+}
+
+///
+// Forget which pixels have been covered
+///
+void Rasterizer::clearOcclusion( void )
+{
+    int w = max( C.getWidth(), 0 );
+    int h = max( n_scanlines, 0 );
+
+    maskWords = (w + 63) / 64;
+    mask.assign( maskWords * h, 0 );
+    rowOpen.assign( h, w );
+}
+
+///
+// Pixel counts
+///
+
+unsigned long Rasterizer::getRasterized( void )
+{
+    return rasterized;
+}
+
+unsigned long Rasterizer::getWritten( void )
+{
+    return written;
+}
+
+void Rasterizer::resetCounts( void )
+{
+    rasterized = written = 0;
+}
+
+///
+// Bytes held by one scratch buffer
+///
+template<class T>
+static inline size_t heldBytes( const vector<T> &v )
+{
+    return v.capacity() * sizeof(T);
+}
+
+///
+// Free one scratch buffer
+///
+template<class T>
+static inline void release( vector<T> &v )
+{
+    vector<T>().swap( v );
+}
+
+///
+// Memory held in scratch buffers
+//
+// @return the size of the scratch buffers, in bytes
+///
+size_t Rasterizer::getScratchBytes( void )
+{
+    return heldBytes( edges ) + heldBytes( shades ) +
+           heldBytes( texAttrib ) + heldBytes( texels ) +
+           heldBytes( active ) + heldBytes( incoming ) +
+           heldBytes( merged ) + heldBytes( blockRuns ) +
+           heldBytes( cells ) + heldBytes( rowCells ) +
+           heldBytes( rowStart ) + heldBytes( clipIn ) +
+           heldBytes( clipOut ) + heldBytes( clipColIn ) +
+           heldBytes( clipColOut ) + heldBytes( batch ) +
+           heldBytes( recorded ) + heldBytes( drawnTiles );
+}
+
+///
+// Free the scratch buffers
+///
+void Rasterizer::releaseScratch( void )
+{
+    release( edges );
+    release( shades );
+    release( texAttrib );
+    release( texels );
+    release( active );
+    release( incoming );
+    release( merged );
+    release( blockRuns );
+    release( cells );
+    release( rowCells );
+    release( rowStart );
+    release( clipIn );
+    release( clipOut );
+    release( clipColIn );
+    release( clipColOut );
+    release( batch );
+    release( recorded );
+    release( drawnTiles );
+}
+
+///
+// Clip a run of pixels and hand it to the canvas
+//
+// @param y  - the scanline
+// @param x0 - first pixel in the run
+// @param x1 - one past the last pixel in the run
+///
+void Rasterizer::emitSpan( int y, int x0, int x1 )
+{
+    x0 = max( x0, clipX0 );
+    x1 = min( x1, clipX1 );
+    if( x0 >= x1 ) {
+        return;
+    }
+
+    putSpan( y, x0, x1, 255 );
+}
+
+///
+// Hand an already clipped run of pixels to the canvas
+//
+// @param y     - the scanline
+// @param x0    - first pixel in the run
+// @param x1    - one past the last pixel in the run
+// @param alpha - coverage, from 1 to 255
+///
+void Rasterizer::putSpan( int y, int x0, int x1, int alpha )
+{
+    if( recording ) {
+        SpanCache::Span s = { y, x0, x1, alpha };
+        recorded.push_back( s );
+    }
+
+    rasterized += x1 - x0;
+
+    if( occlude && alpha == 255 ) {
+        paintVisible( y, x0, x1 );
+        return;
+    }
+
+    paintSpan( y, x0, x1, alpha );
+}
+
+///
+// Hand an already clipped run of pixels to the canvas
+//
+// @param y     - the scanline
+// @param x0    - first pixel in the run
+// @param x1    - one past the last pixel in the run
+// @param alpha - coverage, from 1 to 255
+///
+void Rasterizer::paintSpan( int y, int x0, int x1, int alpha )
+{
+    written += x1 - x0;
+
+    if( alpha < 255 ) {
+        Color c = useFill ? fill : C.getColor();
+        c.a = alpha / 255.0f;
+        C.addSpanBlend( y, x0, x1, c );
+    } else if( useFill ) {
+        C.addSpanColor( y, x0, x1, fill );
+    } else {
+        C.addSpan( y, x0, x1 );
+    }
+}
+
+///
+// Coverage mask helpers
+//
+// A scanline of the mask is an array of 64-bit words; bit i of
+// word k is pixel 64k + i, and is set once the pixel is covered.
+///
+
+///
+// Index of the lowest set bit of a nonzero word
+///
+static inline int lowestBit64( uint64_t m )
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll( m );
+#else
+    int i = 0;
+    while( !( m & 1 ) ) {
+        m >>= 1;
+        ++i;
+    }
+    return i;
+#endif
+}
+
+///
+// First pixel in [x,end) whose bit is 'want' (or 'end' if none)
+///
+static inline int findBit( const uint64_t *row, int x, int end, bool want )
+{
+    while( x < end ) {
+        uint64_t word = want ? row[x >> 6] : ~row[x >> 6];
+        word &= ~0ull << (x & 63);
+        if( word ) {
+            return min( (x & ~63) + lowestBit64( word ), end );
+        }
+        x = (x | 63) + 1;
+    }
+    return end;
+}
+
+///
+// Set the bits of pixels [x0,x1)
+///
+static inline void setBits( uint64_t *row, int x0, int x1 )
+{
+    while( x0 < x1 ) {
+        int base = x0 & ~63;
+        int hi = min( x1 - base, 64 );
+        uint64_t bits = ~0ull << (x0 & 63);
+        if( hi < 64 ) {
+            bits &= (1ull << hi) - 1;
+        }
+        row[x0 >> 6] |= bits;
+        x0 = base + 64;
+    }
+}
+
+///
+// Draw the pixels of a solid run not yet covered, and cover them
+//
+// @param y  - the scanline
+// @param x0 - first pixel in the run
+// @param x1 - one past the last pixel in the run
+///
+void Rasterizer::paintVisible( int y, int x0, int x1 )
+{
+    coverVisible( y, x0, x1, [this, y]( int a, int b ) {
+        paintSpan( y, a, b, 255 );
+    } );
+}
+
+///
+// Cover the pixels of a run not yet covered, and paint them
+//
+// @param y     - the scanline
+// @param x0    - first pixel in the run
+// @param x1    - one past the last pixel in the run
+// @param paint - called as paint(a,b) for each uncovered piece [a,b)
+///
+template<class Paint>
+void Rasterizer::coverVisible( int y, int x0, int x1, Paint paint )
+{
+    if( rowOpen[y] == 0 ) {
+        return;
+    }
+
+    uint64_t *row = &mask[y * maskWords];
+
+    while( x0 < x1 ) {
+        int a = findBit( row, x0, x1, false );
+        if( a >= x1 ) {
+            break;
+        }
+        int b = findBit( row, a, x1, true );
+
+        setBits( row, a, b );
+        rowOpen[y] -= b - a;
+        paint( a, b );
+
+        x0 = b;
+    }
+}
+
+///
+// Is a rectangle entirely covered already?
+//
+// @param x0, y0 - first column and scanline
+// @param x1, y1 - one past the last column and scanline
+// @return true if every pixel in it is covered
+///
+bool Rasterizer::covered( int x0, int y0, int x1, int y1 )
+{
+    for( int y = y0; y < y1; ++y ) {
+        // whole scanlines are settled without looking at the bits
+        if( rowOpen[y] == 0 ) {
+            continue;
+        }
+        if( findBit( &mask[y * maskWords], x0, x1, false ) < x1 ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+///
+// Depth tiles
+//
+// The depth buffer is divided into DEPTH_TILE x DEPTH_TILE tiles.
+// A tile's nearest depth is kept exact as pixels are drawn.  Depths
+// only ever come nearer, so its farthest depth stays a safe bound
+// as they are drawn; once a polygon has drawn every pixel of the
+// tile, the farthest depth it drew there becomes the new bound.
+///
+
+#define DEPTH_TILE      8
+
+///
+// Turn depth testing on or off
+//
+// @param on - true to test depth
+///
+void Rasterizer::setDepthTest( bool on )
+{
+    depthTest = on;
+    if( on ) {
+        clearDepth();
+    }
+}
+
+///
+// Is depth testing on?
+//
+// @return true if it is
+///
+bool Rasterizer::getDepthTest( void )
+{
+    return depthTest;
+}
+
+///
+// Put every depth back at the far plane
+///
+void Rasterizer::clearDepth( void )
+{
+    int w = max( C.getWidth(), 0 );
+    int h = max( n_scanlines, 0 );
+
+    tilesX = (w + DEPTH_TILE - 1) / DEPTH_TILE;
+    int tiles = tilesX * ((h + DEPTH_TILE - 1) / DEPTH_TILE);
+
+    depth.assign( w * h, 1.0f );
+    tileNear.assign( tiles, 1.0f );
+    tileFar.assign( tiles, 1.0f );
+    tileDrawn.assign( tiles, 0 );
+    tileReach.assign( tiles, -INFINITY );
+    drawnTiles.clear();
+}
+
+///
+// Depth test a run of pixels, and paint the ones which pass
+//
+// @param y     - the scanline
+// @param x0    - first pixel in the run
+// @param x1    - one past the last pixel in the run
+// @param z     - depth of pixel x0
+// @param dz    - change in depth from one pixel to the next
+// @param paint - called as paint(a,b) for each passing piece [a,b)
+///
+template<class Paint>
+void Rasterizer::depthVisible( int y, int x0, int x1, float z, float dz,
+                               Paint paint )
+{
+    float *row = &depth[y * C.getWidth()];
+    int tileRow = (y / DEPTH_TILE) * tilesX;
+
+    // passing pixels are gathered into runs across tile boundaries,
+    // so that the canvas sees as few pieces as possible
+    int open = -1;
+
+    for( int x = x0; x < x1; ) {
+        int t = tileRow + x / DEPTH_TILE;
+        int end = min( (x / DEPTH_TILE + 1) * DEPTH_TILE, x1 );
+
+        // z + i * dz is monotonic in i, even rounded, so its values
+        // at the ends of the piece bound it
+        float za = z + (x - x0) * dz;
+        float zb = z + (end - 1 - x0) * dz;
+        float zNear = min( za, zb ), zFar = max( za, zb );
+
+        if( zNear > tileFar[t] ) {
+            // behind everything in the tile
+            if( open >= 0 ) {
+                paint( open, x );
+                open = -1;
+            }
+            x = end;
+            continue;
+        }
+
+        int drawn = end - x;
+
+        if( zFar <= tileNear[t] ) {
+            // in front of everything in the tile
+            for( int i = x; i < end; ++i ) {
+                row[i] = z + (i - x0) * dz;
+            }
+            if( open < 0 ) {
+                open = x;
+            }
+        } else {
+            // test the whole piece first, without branching, keeping
+            // one bit per pixel which passed
+            unsigned pass = 0;
+            for( int i = x; i < end; ++i ) {
+                float zi = z + (i - x0) * dz;
+                pass |= (unsigned) (zi <= row[i]) << (i - x);
+                row[i] = min( row[i], zi );
+            }
+
+            if( pass == 0 ) {
+                if( open >= 0 ) {
+                    paint( open, x );
+                    open = -1;
+                }
+                x = end;
+                continue;
+            }
+
+            // then turn the bits into runs
+            drawn = 0;
+            for( int i = x; i < end; ) {
+                if( pass & 1 ) {
+                    int run = lowestBit64( ~pass );
+                    if( open < 0 ) {
+                        open = i;
+                    }
+                    drawn += run;
+                    i += run;
+                    pass >>= run;
+                } else {
+                    if( open >= 0 ) {
+                        paint( open, i );
+                        open = -1;
+                    }
+                    if( pass == 0 ) {
+                        break;
+                    }
+                    int gap = lowestBit64( pass );
+                    i += gap;
+                    pass >>= gap;
+                }
+            }
+        }
+
+        tileNear[t] = min( tileNear[t], zNear );
+        if( tileDrawn[t] == 0 ) {
+            drawnTiles.push_back( t );
+        }
+        tileDrawn[t] += drawn;
+        tileReach[t] = max( tileReach[t], zFar );
+
+        x = end;
+    }
+
+    if( open >= 0 ) {
+        paint( open, x1 );
+    }
+}
+
+///
+// Settle the tiles the current polygon drew in
+//
+// A polygon draws each pixel at most once, so a tile it drew all of
+// has nothing farther in it than the farthest depth drawn there.
+///
+void Rasterizer::settleTiles( void )
+{
+    int w = C.getWidth();
+
+    for( size_t k = 0; k < drawnTiles.size(); ++k ) {
+        int t = drawnTiles[k];
+        int tw = min( w - (t % tilesX) * DEPTH_TILE, DEPTH_TILE );
+        int th = min( n_scanlines - (t / tilesX) * DEPTH_TILE, DEPTH_TILE );
+
+        if( tileDrawn[t] == tw * th ) {
+            tileFar[t] = min( tileFar[t], tileReach[t] );
+        }
+
+        tileDrawn[t] = 0;
+        tileReach[t] = -INFINITY;
+    }
+
+    drawnTiles.clear();
+}
+
+///
+// Edge stepping helpers
+//
+// These hide the difference between the floating-point and the
+// fixed-point (RAST_FIXED_POINT) edge representations.  They are
+// templates only so that they can name the Rasterizer's private
+// Edge type.
+///
+
+#ifdef RAST_FIXED_POINT
+
+// one pixel, in fixed point
+static const int FIXED_ONE = 1 << RAST_FIXED_BITS;
+
+// largest step in x per scanline an edge is given (16384 pixels at
+// 16 bits of fraction), leaving x plenty of room before it overflows
+static const int MAX_STEP = 1 << 30;
+
+///
+// Convert a coordinate to fixed point, rounding to nearest
+///
+static inline int toFixed( float v )
+{
+    return (int) floor( (double) v * FIXED_ONE + 0.5 );
+}
+
+///
+// Smallest pixel coordinate >= a fixed-point value
+///
+static inline int fixedCeil( int v )
+{
+    return (v + FIXED_ONE - 1) >> RAST_FIXED_BITS;
+}
+
+///
+// Quotient of a / b rounded toward negative infinity (b > 0)
+///
+static inline long long floorDiv( long long a, long long b )
+{
+    long long q = a / b;
+    return (a % b < 0) ? q - 1 : q;
+}
+
+///
+// First pixel at or to the right of the edge on this scanline
+//
+// The exact crossing is x + rem/dy with 0 <= rem < dy, so any
+// nonzero remainder pushes it past x.
+///
+template<class Edge>
+static inline int edgePixel( const Edge &e )
+{
+    return fixedCeil( e.x + (e.rem > 0) );
+}
+
+///
+// Where the edge crosses this scanline, in pixels
+///
+template<class Edge>
+static inline float edgeX( const Edge &e )
+{
+    return (e.x + (float) e.rem / e.dy) * (1.0f / FIXED_ONE);
+}
+
+///
+// Is edge a left of edge b on this scanline?
+///
+template<class Edge>
+static inline bool edgeLess( const Edge &a, const Edge &b )
+{
+    if( a.x != b.x ) {
+        return a.x < b.x;
+    }
+    return (long long) a.rem * b.dy < (long long) b.rem * a.dy;
+}
+
+///
+// Move an edge up to scanline y (which is always the next one)
+///
+template<class Edge>
+static inline void stepEdge( Edge &e, int y )
+{
+    (void) y;
+    e.x += e.stepX;
+    e.rem += e.stepRem;
+
+    // carry the remainder without a branch
+    int carry = -(e.rem >= e.dy);
+    e.x -= carry;
+    e.rem -= carry & e.dy;
+}
+
+#else
+
+///
+// First pixel at or to the right of the edge on this scanline
+///
+template<class Edge>
+static inline int edgePixel( const Edge &e )
+{
+    return (int) ceilf( e.x );
+}
+
+///
+// Where the edge crosses this scanline, in pixels
+///
+template<class Edge>
+static inline float edgeX( const Edge &e )
+{
+    return e.x;
+}
+
+///
+// Is edge a left of edge b on this scanline?
+///
+template<class Edge>
+static inline bool edgeLess( const Edge &a, const Edge &b )
+{
+    return a.x < b.x;
+}
+
+///
+// Move an edge up to scanline y
+///
+template<class Edge>
+static inline void stepEdge( Edge &e, int y )
+{
+    e.x = e.xLo + (y - e.yLo) * e.dxdy;
+}
+
+#endif
+
+///
+// Set up the edge (v0,v1) for the scanlines it covers
+//
+// Horizontal edges, edges which do not cross a scanline, and
+// edges entirely outside the scanlines yMin <= y < clipY1 are
+// rejected.
+//
+// @param v0     - first endpoint
+// @param v1     - second endpoint
+// @param yMin   - first scanline the edge may start on
+// @param e      - the edge, ready for its first scanline
+// @param yStart - its first scanline
+// @return false if the edge was rejected
+///
+bool Rasterizer::makeEdge( const Vertex &v0, const Vertex &v1, int yMin,
+                           Edge &e, int &yStart )
+{
+    // orient the edge so that it runs from bottom to top
+    const Vertex &lo = v0.y < v1.y ? v0 : v1;
+    const Vertex &hi = v0.y < v1.y ? v1 : v0;
+
+#ifdef RAST_FIXED_POINT
+    int xLo = toFixed( lo.x ), yLoF = toFixed( lo.y );
+    int xHi = toFixed( hi.x ), yHiF = toFixed( hi.y );
+
+    yStart = fixedCeil( yLoF );
+    int yEnd = fixedCeil( yHiF );
+#else
+    yStart = (int) ceilf( lo.y );
+    int yEnd = (int) ceilf( hi.y );
+#endif
+
+    // horizontal, or falls between two scanlines
+    if( yStart >= yEnd ) {
+        return false;
+    }
+
+    // entirely below or above the scanlines wanted
+    if( yEnd <= yMin || yStart >= clipY1 ) {
+        return false;
+    }
+
+    // start below them? begin at the first one wanted
+    if( yStart < yMin ) {
+        yStart = yMin;
+    }
+
+#ifdef RAST_FIXED_POINT
+    // x = xLo + (Y - yLoF) * dx / dy, split into quotient and remainder
+    long long dx = xHi - xLo;
+    e.dy = yHiF - yLoF;
+
+    long long num = (long long) yStart * FIXED_ONE - yLoF;
+    num *= dx;
+    long long q = floorDiv( num, e.dy );
+    e.x = xLo + (int) q;
+    e.rem = (int) (num - q * e.dy);
+
+    // a near-horizontal edge can step further than an int holds; it
+    // can't cross two scanlines of a guard-band-clipped polygon, so
+    // its step need only keep its sign (and x from overflowing)
+    num = dx * FIXED_ONE;
+    q = floorDiv( num, e.dy );
+    if( q > MAX_STEP || q < -MAX_STEP ) {
+        e.stepX = q > 0 ? MAX_STEP : -MAX_STEP;
+        e.stepRem = 0;
+    } else {
+        e.stepX = (int) q;
+        e.stepRem = (int) (num - q * e.dy);
+    }
+#else
+    e.dxdy = (hi.x - lo.x) / (hi.y - lo.y);
+    e.xLo = lo.x;
+    e.yLo = lo.y;
+    e.x = lo.x + (yStart - lo.y) * e.dxdy;
+#endif
+
+    e.yEnd = yEnd < clipY1 ? yEnd : clipY1;
+    e.dir = v0.y < v1.y ? 1 : -1;
+    e.next = -1;
+
+    return true;
+}
+
+///
+// Add the edge (v0,v1) to the edge table
+//
+// Horizontal edges, edges which do not cross a scanline, and
+// edges entirely outside the scanline range are dropped here.
+//
+// @param v0 - first endpoint
+// @param v1 - second endpoint
+///
+void Rasterizer::addEdge( const Vertex &v0, const Vertex &v1 )
+{
+    Edge e;
+    int yStart;
+
+    if( !makeEdge( v0, v1, clipY0, e, yStart ) ) {
+        return;
+    }
+
+    // push onto the front of this scanline's bucket
+    e.next = buckets[yStart];
+    buckets[yStart] = (int) edges.size();
+    edges.push_back( e );
+
+    yLo = min( yLo, yStart );
+    yHi = max( yHi, e.yEnd );
+}
+
+///
+// Add the edge (v0,v1) of a shaded or depth-tested polygon to the
+// edge table
+//
+// @param v0 - first endpoint
+// @param c0 - its color
+// @param v1 - second endpoint
+// @param c1 - its color
+///
+void Rasterizer::addShadedEdge( const Vertex &v0, const Color &c0,
+                                const Vertex &v1, const Color &c1 )
+{
+    Edge e;
+    int yStart;
+
+    if( !makeEdge( v0, v1, clipY0, e, yStart ) ) {
+        return;
+    }
+
+    // the same orientation as makeEdge()
+    bool up = v0.y < v1.y;
+    const Vertex &lo = up ? v0 : v1;
+    const Vertex &hi = up ? v1 : v0;
+    const Color &cLo = up ? c0 : c1;
+    const Color &cHi = up ? c1 : c0;
+
+    float from[4] = { cLo.r, cLo.g, cLo.b, cLo.a };
+    float to[4] = { cHi.r, cHi.g, cHi.b, cHi.a };
+    float dy = hi.y - lo.y;
+
+    EdgeShade s;
+    for( int k = 0; k < 4; ++k ) {
+        s.dc[k] = (to[k] - from[k]) / dy;
+        s.c[k] = from[k] + (yStart - lo.y) * s.dc[k];
+    }
+    s.dz = (hi.z - lo.z) / dy;
+    s.z = lo.z + (yStart - lo.y) * s.dz;
+
+    e.next = buckets[yStart];
+    buckets[yStart] = (int) edges.size();
+    edges.push_back( e );
+    shades.push_back( s );
+
+    yLo = min( yLo, yStart );
+    yHi = max( yHi, e.yEnd );
+}
+
+///
+// Fill between two active edges on a scanline
+//
+// @param y - the scanline
+// @param a - the left edge
+// @param b - the right edge
+///
+template<bool shaded>
+inline void Rasterizer::fillRun( int y, int a, int b )
+{
+    if( shaded ) {
+        emitShaded( y, a, b );
+    } else {
+        emitSpan( y, edgePixel( edges[a] ), edgePixel( edges[b] ) );
+    }
+}
+
+///
+// Clip a run of pixels between two edges of a shaded or
+// depth-tested polygon, and hand it to the canvas
+//
+// @param y - the scanline
+// @param a - the left edge
+// @param b - the right edge
+///
+void Rasterizer::emitShaded( int y, int a, int b )
+{
+    const Edge &l = edges[a];
+    const Edge &r = edges[b];
+
+    int x0 = max( edgePixel( l ), clipX0 );
+    int x1 = min( edgePixel( r ), clipX1 );
+    if( x0 >= x1 ) {
+        return;
+    }
+
+    // the one division for the whole span
+    float xl = edgeX( l );
+    float w = edgeX( r ) - xl;
+    float inv = w > 0.0f ? 1.0f / w : 0.0f;
+
+    const EdgeShade &sl = shades[a];
+    const EdgeShade &sr = shades[b];
+
+    Color c = { 0.0f, 0.0f, 0.0f, 0.0f };
+    Color dc = c;
+    if( shadeMode != SHADE_FLAT ) {
+        float d[4], s[4];
+        for( int k = 0; k < 4; ++k ) {
+            d[k] = (sr.c[k] - sl.c[k]) * inv;
+            s[k] = sl.c[k] + (x0 - xl) * d[k];
+        }
+        Color start = { s[0], s[1], s[2], s[3] };
+        Color step = { d[0], d[1], d[2], d[3] };
+        c = start;
+        dc = step;
+    }
+
+    rasterized += x1 - x0;
+
+    auto paint = [this, y, x0, &c, &dc]( int p, int q ) {
+        if( shadeMode == SHADE_FLAT ) {
+            paintSpan( y, p, q, 255 );
+            return;
+        }
+        float i = (float) (p - x0);
+        Color cp = {
+            c.r + i * dc.r, c.g + i * dc.g, c.b + i * dc.b, c.a + i * dc.a
+        };
+        written += q - p;
+        if( shadeMode == SHADE_TEXTURE ) {
+            float a[3] = { cp.r, cp.g, cp.b };
+            float da[3] = { dc.r, dc.g, dc.b };
+            textureSpan( y, p, q, a, da );
+        } else {
+            C.addSpanShaded( y, p, q, cp, dc );
+        }
+    };
+
+    // when drawing front to back, only the pieces not yet covered
+    auto uncovered = [this, y, &paint]( int p, int q ) {
+        if( occlude ) {
+            coverVisible( y, p, q, paint );
+        } else {
+            paint( p, q );
+        }
+    };
+
+    if( depthTest ) {
+        float dz = (sr.z - sl.z) * inv;
+        depthVisible( y, x0, x1, sl.z + (x0 - xl) * dz, dz, uncovered );
+    } else {
+        uncovered( x0, x1 );
+    }
+}
+
+///
+// Texture spans
+//
+// u and v are found exactly (with a division) every TEX_SUBSPAN
+// pixels, and followed in a straight line in between.
+///
+
+#define TEX_SUBSPAN     16
+
+///
+// Texture a run of pixels, and hand it to the canvas
+//
+// @param y  - the scanline
+// @param x0 - first pixel in the run
+// @param x1 - one past the last pixel in the run
+// @param a  - u/w, v/w, and 1/w at pixel x0
+// @param da - their change from one pixel to the next
+///
+void Rasterizer::textureSpan( int y, int x0, int x1, const float a[3],
+                              const float da[3] )
+{
+    int n = x1 - x0;
+    texels.resize( n );
+
+    // u and v at pixel x0 + i
+    auto exact = [a, da]( int i, float &u, float &v ) {
+        float q = 1.0f / (a[2] + i * da[2]);
+        u = (a[0] + i * da[0]) * q;
+        v = (a[1] + i * da[1]) * q;
+    };
+
+    float u0, v0;
+    exact( 0, u0, v0 );
+
+    for( int i = 0; i < n; i += TEX_SUBSPAN ) {
+        int len = min( n - i, TEX_SUBSPAN );
+
+        // aim at the first pixel of the next piece, or at the last
+        // pixel of the run if this is the last piece
+        int end = i + len < n ? i + len : n - 1;
+
+        float u1 = u0, v1 = v0, du = 0.0f, dv = 0.0f;
+        if( end > i ) {
+            exact( end, u1, v1 );
+            float k = end - i == TEX_SUBSPAN ? 1.0f / TEX_SUBSPAN
+                                             : 1.0f / (end - i);
+            du = (u1 - u0) * k;
+            dv = (v1 - v0) * k;
+        }
+
+        texture->sampleSpan( &texels[i], len, u0, v0, du, dv );
+
+        u0 = u1;
+        v0 = v1;
+    }
+
+    C.addSpanPixels( y, x0, x1, &texels[0] );
+}
+
+///
+// Run the scanline sweep over the current edge table
+//
+// The fill rule is a template parameter so that each rule gets
+// its own copy of the sweep, with no test in the inner loop; so
+// is whether the polygon is shaded.
+///
+template<FillRule rule, bool shaded>
+void Rasterizer::fillEdges( void )
+{
+    active.clear();
+
+    for( int y = yLo; y < yHi; ++y ) {
+
+        // retire edges whose top lies at or below this scanline
+        size_t k = 0;
+        for( size_t i = 0; i < active.size(); ++i ) {
+            if( edges[active[i]].yEnd > y ) {
+                active[k++] = active[i];
+            }
+        }
+        active.resize( k );
+
+        // bring in the edges which start on this scanline
+        if( buckets[y] >= 0 ) {
+            incoming.clear();
+            for( int e = buckets[y]; e >= 0; e = edges[e].next ) {
+                incoming.push_back( e );
+            }
+            buckets[y] = -1;
+
+            // edges starting at the same point are ordered by
+            // where they will be one scanline later
+            sort( incoming.begin(), incoming.end(),
+                  [this, y]( int a, int b ) {
+                      if( edgeLess( edges[a], edges[b] ) ) {
+                          return true;
+                      }
+                      if( edgeLess( edges[b], edges[a] ) ) {
+                          return false;
+                      }
+                      Edge ea = edges[a], eb = edges[b];
+                      stepEdge( ea, y + 1 );
+                      stepEdge( eb, y + 1 );
+                      return edgeLess( ea, eb );
+                  } );
+
+            merged.resize( active.size() + incoming.size() );
+            merge( active.begin(), active.end(),
+                   incoming.begin(), incoming.end(), merged.begin(),
+                   [this]( int a, int b ) {
+                       return edgeLess( edges[a], edges[b] );
+                   } );
+            active.swap( merged );
+        }
+
+        // fill where the fill rule says we're inside
+        if( rule == FILL_EVEN_ODD ) {
+            for( size_t i = 0; i + 1 < active.size(); i += 2 ) {
+                fillRun<shaded>( y, active[i], active[i + 1] );
+            }
+        } else {
+            int winding = 0, left = 0;
+            for( size_t i = 0; i < active.size(); ++i ) {
+                if( winding == 0 ) {
+                    left = active[i];
+                }
+                winding += edges[active[i]].dir;
+                if( winding == 0 ) {
+                    fillRun<shaded>( y, left, active[i] );
+                }
+            }
+        }
+
+        // step every active edge to the next scanline
+        for( size_t i = 0; i < active.size(); ++i ) {
+            stepEdge( edges[active[i]], y + 1 );
+            if( shaded ) {
+                EdgeShade &s = shades[active[i]];
+                for( int k = 0; k < 4; ++k ) {
+                    s.c[k] += s.dc[k];
+                }
+                s.z += s.dz;
+            }
+        }
+
+        // edges only swap places where they cross, so a simple
+        // insertion sort restores the ordering in near-linear time
+        for( size_t i = 1; i < active.size(); ++i ) {
+            int key = active[i];
+            size_t j = i;
+            while( j > 0 && edgeLess( edges[key], edges[active[j - 1]] ) ) {
+                active[j] = active[j - 1];
+                --j;
+            }
+            active[j] = key;
+        }
+    }
+}
+
+///
+// Classify a polygon by the shape of its outline
+//
+// The polygon is y-monotone if, going around it, y rises and then
+// falls only once (horizontal steps don't count); it is convex if
+// it is y-monotone and it also turns the same way at every vertex.
+//
+// @param n - number of vertices
+// @param v - array of vertices
+// @return the polygon's class
+///
+PolygonClass classifyPolygon( int n, const Vertex v[] )
+{
+    int firstDir = 0, lastDir = 0, changes = 0;
+    int lastTurn = 0;
+    bool convex = true;
+
+    for( int i = 0; i < n; ++i ) {
+        const Vertex &a = v[i];
+        const Vertex &b = v[(i + 1) % n];
+        const Vertex &c = v[(i + 2) % n];
+
+        int dir = (b.y > a.y) - (b.y < a.y);
+        if( dir != 0 ) {
+            if( lastDir != 0 && dir != lastDir ) {
+                ++changes;
+            }
+            if( firstDir == 0 ) {
+                firstDir = dir;
+            }
+            lastDir = dir;
+        }
+
+        float cross = (b.x - a.x) * (c.y - b.y) - (b.y - a.y) * (c.x - b.x);
+        int turn = (cross > 0.0f) - (cross < 0.0f);
+        if( turn != 0 ) {
+            if( lastTurn != 0 && turn != lastTurn ) {
+                convex = false;
+            }
+            lastTurn = turn;
+        }
+    }
+
+    // close the loop
+    if( lastDir != firstDir ) {
+        ++changes;
+    }
+
+    if( changes > 2 ) {
+        return POLY_GENERAL;
+    }
+    return convex ? POLY_CONVEX : POLY_MONOTONE;
+}
+
+///
+// Fill a y-monotone polygon by walking its two sides
+//
+// Starting from the lowest vertex, one side follows the vertices
+// forward and the other backward; each holds the single edge it
+// crosses on the current scanline.  Every scanline meets the
+// polygon in one run, between the two sides, so no edge table or
+// sorting is needed.  The edges are the same ones the edge table
+// would build, so the pixels filled are exactly the same.
+//
+// @param n - number of vertices
+// @param v - array of vertices
+///
+void Rasterizer::fillMonotone( int n, const Vertex v[] )
+{
+    int bottom = 0;
+    for( int i = 1; i < n; ++i ) {
+        if( v[i].y < v[bottom].y ) {
+            bottom = i;
+        }
+    }
+
+    Edge side[2];
+    int at[2] = { bottom, bottom };         // lower vertex of the edge
+    const int dir[2] = { 1, n - 1 };        // forward, backward
+    int used[2] = { 0, 0 };                 // edges taken so far
+
+    // move side s on to its next edge reaching above scanline y
+    auto advance = [&]( int s, int y, int &yStart ) {
+        while( used[s] < n ) {
+            int next = (at[s] + dir[s]) % n;
+            bool ok = makeEdge( v[at[s]], v[next], y, side[s], yStart );
+
+            at[s] = next;
+            ++used[s];
+            if( ok ) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // the sides meet at the bottom vertex, so both start on the
+    // same scanline, and each edge starts where the last one ended
+    int y, yStart;
+    if( !advance( 0, clipY0, y ) || !advance( 1, clipY0, yStart ) ) {
+        return;
+    }
+
+    for( ;; ) {
+        int xl = edgePixel( side[0] );
+        int xr = edgePixel( side[1] );
+        emitSpan( y, min( xl, xr ), max( xl, xr ) );
+
+        // past the clipping rectangle, a side could carry on down
+        // the far side of the polygon, so stop here explicitly
+        if( ++y >= clipY1 ) {
+            return;
+        }
+        for( int s = 0; s < 2; ++s ) {
+            if( side[s].yEnd > y ) {
+                stepEdge( side[s], y );
+            } else if( !advance( s, y, yStart ) ) {
+                return;
+            }
+        }
+    }
+}
+
+///
+// Guard band
+//
+// Polygons which reach more than GUARD_BAND pixels beyond the canvas
+// are clipped to that wider rectangle before they are filled; the
+// rest are only clipped a scanline (and a span) at a time as they are
+// filled.  The guard band is fixed to the canvas, not to the clipping
+// rectangle, so a polygon is cut the same way whichever part of the
+// canvas is being drawn, and its pixels don't change.
+///
+
+#define GUARD_BAND      256.0f
+
+///
+// Where an edge crosses one side of a rectangle
+//
+// @param a, b  - the edge's endpoints, on either side of it
+// @param axis  - 0 for a vertical side (x = bound), 1 for horizontal
+// @param bound - where the side is
+// @param t     - how far along the edge the crossing is (set)
+//
+// @return the crossing point
+///
+static inline Vertex crossing( const Vertex &a, const Vertex &b,
+                               int axis, float bound, float &t )
+{
+    float ca = axis ? a.y : a.x;
+    float cb = axis ? b.y : b.x;
+    t = (bound - ca) / (cb - ca);
+
+    Vertex p = {
+        a.x + t * (b.x - a.x), a.y + t * (b.y - a.y),
+        a.z + t * (b.z - a.z), a.w + t * (b.w - a.w)
+    };
+    if( axis ) {
+        p.y = bound;
+    } else {
+        p.x = bound;
+    }
+    return p;
+}
+
+///
+// Clip a polygon to one side of a rectangle (Sutherland-Hodgman)
+//
+// @param in     - the polygon
+// @param out    - the part of it on the inside of the side
+// @param colIn  - colors of the polygon's vertices (NULL if none)
+// @param colOut - colors of the clipped polygon's vertices
+// @param axis   - 0 for a vertical side (x = bound), 1 for horizontal
+// @param bound  - where the side is
+// @param above  - true if the inside is where the coordinate >= bound
+///
+static void clipSide( const vector<Vertex> &in, vector<Vertex> &out,
+                      const vector<Color> *colIn, vector<Color> *colOut,
+                      int axis, float bound, bool above )
+{
+    out.clear();
+    if( colIn ) {
+        colOut->clear();
+    }
+
+    size_t n = in.size();
+    for( size_t i = 0; i < n; ++i ) {
+        const Vertex &a = in[i];
+        const Vertex &b = in[(i + 1) % n];
+        float ca = axis ? a.y : a.x;
+        float cb = axis ? b.y : b.x;
+        bool ina = above ? ca >= bound : ca <= bound;
+        bool inb = above ? cb >= bound : cb <= bound;
+
+        if( ina ) {
+            out.push_back( a );
+            if( colIn ) {
+                colOut->push_back( (*colIn)[i] );
+            }
+        }
+
+        // crossing the side: add the crossing point
+        if( ina != inb ) {
+            float t;
+            out.push_back( crossing( a, b, axis, bound, t ) );
+
+            if( colIn ) {
+                const Color &ka = (*colIn)[i];
+                const Color &kb = (*colIn)[(i + 1) % n];
+                Color k = {
+                    ka.r + t * (kb.r - ka.r), ka.g + t * (kb.g - ka.g),
+                    ka.b + t * (kb.b - ka.b), ka.a + t * (kb.a - ka.a)
+                };
+                colOut->push_back( k );
+            }
+        }
+    }
+}
+
+///
+// Clip a polygon to the guard band, if it reaches beyond it
+//
+// @param n - number of vertices (updated)
+// @param v - array of vertices (updated to point at the clipped copy)
+///
+void Rasterizer::clipToGuardBand( int &n, const Vertex *&v )
+{
+    const Color *none = 0;
+    clipToGuardBand( n, v, none );
+}
+
+///
+// Clip a shaded polygon to the guard band, colors and all
+//
+// @param n - number of vertices (updated)
+// @param v - array of vertices (updated to point at the clipped copy)
+// @param c - array of colors (updated to point at the clipped copy);
+//            NULL if the polygon has none
+///
+void Rasterizer::clipToGuardBand( int &n, const Vertex *&v, const Color *&c )
+{
+    float gx0 = -GUARD_BAND, gx1 = C.getWidth() + GUARD_BAND;
+    float gy0 = -GUARD_BAND, gy1 = n_scanlines + GUARD_BAND;
+
+    float xmin = v[0].x, xmax = v[0].x, ymin = v[0].y, ymax = v[0].y;
+    for( int i = 1; i < n; ++i ) {
+        xmin = min( xmin, v[i].x );
+        xmax = max( xmax, v[i].x );
+        ymin = min( ymin, v[i].y );
+        ymax = max( ymax, v[i].y );
+    }
+
+    if( xmin >= gx0 && xmax <= gx1 && ymin >= gy0 && ymax <= gy1 ) {
+        return;
+    }
+
+    // only cut along the sides the polygon actually crosses
+    const vector<Color> *colIn = c ? &clipColIn : 0;
+    vector<Color> *colOut = c ? &clipColOut : 0;
+
+    clipIn.assign( v, v + n );
+    if( c ) {
+        clipColIn.assign( c, c + n );
+    }
+
+    if( xmin < gx0 ) {
+        clipSide( clipIn, clipOut, colIn, colOut, 0, gx0, true );
+        clipIn.swap( clipOut );
+        clipColIn.swap( clipColOut );
+    }
+    if( xmax > gx1 ) {
+        clipSide( clipIn, clipOut, colIn, colOut, 0, gx1, false );
+        clipIn.swap( clipOut );
+        clipColIn.swap( clipColOut );
+    }
+    if( ymin < gy0 ) {
+        clipSide( clipIn, clipOut, colIn, colOut, 1, gy0, true );
+        clipIn.swap( clipOut );
+        clipColIn.swap( clipColOut );
+    }
+    if( ymax > gy1 ) {
+        clipSide( clipIn, clipOut, colIn, colOut, 1, gy1, false );
+        clipIn.swap( clipOut );
+        clipColIn.swap( clipColOut );
+    }
+
+    n = clipIn.size();
+    v = n > 0 ? &clipIn[0] : 0;
+    if( c ) {
+        c = n > 0 ? &clipColIn[0] : 0;
+    }
+}
+
+///
+// Draw a filled polygon.
+//
+// Implementation uses the scan-line polygon fill algorithm with a
+// bucketed edge table and an incrementally maintained active edge
+// list, so the cost is O(E log E) for edge setup plus the number
+// of pixels filled.  Polygons entirely outside the clipping rectangle
+// are rejected up front, and those reaching far beyond the canvas are
+// clipped to the guard band first.
+//
+// The polygon has n distinct vertices.  The coordinates of the vertices
+// making up the polygon are supplied in the 'v' array parameter, such
+// that the ith vertex is in v[i].
+//
+// @param n - number of vertices
+// @param v - array of vertices
+///
+void Rasterizer::drawPolygon( int n, const Vertex v[] )
+{
+    if( !cache || n < 3 || depthTest ) {
+        fillPolygon( n, v );
+        return;
+    }
+
+    int clip[4] = { clipX0, clipY0, clipX1, clipY1 };
+    int mode = fillRule | ( antialias ? 2 : 0 );
+
+    const vector<SpanCache::Span> *hit = cache->find( n, v, clip, mode );
+    if( hit ) {
+        for( size_t i = 0; i < hit->size(); ++i ) {
+            const SpanCache::Span &s = (*hit)[i];
+            putSpan( s.y, s.x0, s.x1, s.alpha );
+        }
+        return;
+    }
+
+    recorded.clear();
+    recording = true;
+    fillPolygon( n, v );
+    recording = false;
+
+    cache->insert( n, v, clip, mode, recorded );
+}
+
+///
+// Can a polygon be skipped without being rasterized?
+//
+// @param n - number of vertices
+// @param v - array of vertices
+// @return true if none of it can be seen
+///
+bool Rasterizer::unseen( int n, const Vertex v[] )
+{
+    float xmin = v[0].x, xmax = v[0].x, ymin = v[0].y, ymax = v[0].y;
+    for( int i = 1; i < n; ++i ) {
+        xmin = min( xmin, v[i].x );
+        xmax = max( xmax, v[i].x );
+        ymin = min( ymin, v[i].y );
+        ymax = max( ymax, v[i].y );
+    }
+
+    return unseenBox( xmin, ymin, xmax, ymax );
+}
 
-using namespace std;
+///
+// Can a shape be skipped without being rasterized?
+//
+// @param xmin, ymin - lower left corner of its bounding box
+// @param xmax, ymax - upper right corner of its bounding box
+// @return true if none of it can be seen
+///
+bool Rasterizer::unseenBox( float xmin, float ymin, float xmax, float ymax )
+{
+    if( clipY0 >= clipY1 || clipX0 >= clipX1 ) {
+        return true;
+    }
 
-truct Vertex{
-	int x;
-	int y;
-};
+    // nowhere near the clipping rectangle?  (the margin covers
+    // the half pixel an anti-aliased edge can reach outward)
+    if( xmax < clipX0 - 1 || xmin > clipX1 + 1 ||
+        ymax < clipY0 - 1 || ymin > clipY1 + 1 ) {
+        return true;
+    }
+
+    // hidden behind what has been drawn already?  (the box is
+    // widened by a pixel each way, as above)
+    if( occlude ) {
+        int bx0 = xmin > clipX0 ? max( (int) xmin - 1, clipX0 ) : clipX0;
+        int by0 = ymin > clipY0 ? max( (int) ymin - 1, clipY0 ) : clipY0;
+        int bx1 = xmax < clipX1 ? min( (int) xmax + 2, clipX1 ) : clipX1;
+        int by1 = ymax < clipY1 ? min( (int) ymax + 2, clipY1 ) : clipY1;
+        if( covered( bx0, by0, bx1, by1 ) ) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+///
+// Rasterize a filled polygon (drawPolygon() without the cache)
+//
+// @param n            - number of vertices
+// @param v            - array of vertices
+// @param tryHalfSpace - false if fillTriangle() has already turned
+//                       this triangle down
+///
+void Rasterizer::fillPolygon( int n, const Vertex v[], bool tryHalfSpace )
+{
+    if( depthTest ) {
+        fillShaded( n, v, 0, SHADE_FLAT );
+        return;
+    }
+
+    if( n < 3 || unseen( n, v ) ) {
+        return;
+    }
+
+    clipToGuardBand( n, v );
+    if( n < 3 ) {
+        return;
+    }
+
+    if( antialias ) {
+        fillCoverage( n, v );
+        return;
+    }
+
+    if( n == 3 && tryHalfSpace && fillTriangle( v[0], v[1], v[2] ) ) {
+        return;
+    }
+
+    // one run per scanline? walk the two sides instead
+    if( classifyPolygon( n, v ) != POLY_GENERAL ) {
+        fillMonotone( n, v );
+        return;
+    }
+
+    edges.clear();
+    yLo = clipY1;
+    yHi = 0;
+
+    for( int i = 0; i < n; ++i ) {
+        addEdge( v[i], v[(i + 1) % n] );
+    }
+
+    if( edges.empty() ) {
+        return;
+    }
+
+    if( fillRule == FILL_NONZERO ) {
+        fillEdges<FILL_NONZERO, false>();
+    } else {
+        fillEdges<FILL_EVEN_ODD, false>();
+    }
+}
+
+///
+// Draw a filled polygon in the specified color
+//
+// Identical to drawPolygon(n,v), except that the color is given
+// here instead of being taken from the canvas.
+//
+// @param n - number of vertices
+// @param v - array of vertices
+// @param c - the fill color
+///
+void Rasterizer::drawPolygon( int n, const Vertex v[], Color c )
+{
+    useFill = true;
+    fill = c;
+
+    drawPolygon( n, v );
+
+    useFill = false;
+}
+
+///
+// Draw a filled polygon with colors interpolated from its vertices
+//
+// @param n - number of vertices
+// @param v - array of vertices
+// @param c - array of colors; c[i] is the color at v[i]
+///
+void Rasterizer::drawPolygon( int n, const Vertex v[], const Color c[] )
+{
+    fillShaded( n, v, c, SHADE_COLOR );
+}
+
+///
+// Draw a polygon filled from a texture
+//
+// u/w, v/w, and 1/w change linearly across the screen, so they go
+// through the edge table (and the guard band) in place of a color.
+//
+// @param n   - number of vertices
+// @param v   - array of vertices (every w must be positive)
+// @param t   - array of texture coordinates; t[i] belongs to v[i]
+// @param tex - the texture
+///
+void Rasterizer::drawPolygon( int n, const Vertex v[], const TexCoord t[],
+                              Texture &tex )
+{
+    if( n < 3 ) {
+        return;
+    }
+
+    texAttrib.resize( n );
+    for( int i = 0; i < n; ++i ) {
+        float q = 1.0f / v[i].w;
+        Color a = { t[i].u * q, t[i].v * q, q, 0.0f };
+        texAttrib[i] = a;
+    }
+
+    texture = &tex;
+    fillShaded( n, v, &texAttrib[0], SHADE_TEXTURE );
+    texture = 0;
+}
+
+///
+// Rasterize a polygon through the edge table, interpolating
+// color and depth from its vertices
+//
+// The edge table carries each edge's color and depth along with
+// its x.  Polygons of a single color come through here only to be
+// depth tested; their spans keep the fill color.
+//
+// @param n    - number of vertices
+// @param v    - array of vertices
+// @param c    - array of colors (NULL for SHADE_FLAT)
+// @param mode - how to paint the spans
+///
+void Rasterizer::fillShaded( int n, const Vertex v[], const Color c[],
+                             ShadeMode mode )
+{
+    if( n < 3 || unseen( n, v ) ) {
+        return;
+    }
+
+    clipToGuardBand( n, v, c );
+    if( n < 3 ) {
+        return;
+    }
+
+    edges.clear();
+    shades.clear();
+    yLo = clipY1;
+    yHi = 0;
+
+    Color none = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for( int i = 0; i < n; ++i ) {
+        int j = (i + 1) % n;
+        addShadedEdge( v[i], c ? c[i] : none, v[j], c ? c[j] : none );
+    }
 
+    if( edges.empty() ) {
+        return;
+    }
 
-struct bucket{
-	int yMax, yMin;
-	float x;
-	float invSlope;
+    shadeMode = mode;
+    if( fillRule == FILL_NONZERO ) {
+        fillEdges<FILL_NONZERO, true>();
+    } else {
+        fillEdges<FILL_EVEN_ODD, true>();
+    }
+    shadeMode = SHADE_COLOR;
+
+    if( depthTest ) {
+        settleTiles();
+    }
+}
+
+///
+// Triangle setup limits
+//
+// Edge functions are evaluated in 32-bit integers on a 1/16 pixel
+// grid.  Only triangles whose vertices already lie on that grid are
+// filled this way, as those are the ones for which the integer edge
+// functions give exactly the pixels the scanline fill would; any
+// other triangle would not share its edges cleanly with polygons
+// filled by the scanline fill.  Keeping the coordinates within
+// TRI_MAX_COORD keeps every value the walk can produce well inside
+// that range.  Triangles more than TRI_MAX_EXTENT pixels across go to
+// the scanline fill too, which fills them faster:  the block walk
+// tests every pixel along the edges, while the scanline walk only
+// tests the two ends of a span.
+///
+
+#define TRI_SUBPIXEL    16
+#define TRI_BLOCK       8
+#define TRI_MAX_EXTENT  16.0f
+#define TRI_MAX_COORD   1048576.0f
+
+///
+// One edge function, E(x,y) = A*x + B*y + C, at pixel (x,y)
+//
+// 'C' already includes the fill-rule bias, so a pixel is inside
+// the edge exactly when E >= 0.  The origin (x = y = 0) is moved
+// to the corner of the triangle's bounding box during setup, which
+// keeps every value in range of a 32-bit int.
+///
+struct TriEdge {
+    int A, B, C;
 };
 
 ///
-// Constructor
+// Evaluate an edge function at pixel (x,y), relative to the origin
+///
+static inline int triEval( const TriEdge &e, int x, int y )
+{
+    return e.A * x + e.B * y + e.C;
+}
+
+///
+// Coverage mask of 8 pixels starting at (x,y); bit i is pixel x + i
+///
+static inline unsigned triRowMask( const TriEdge e[3], int x, int y )
+{
+#if defined(__SSE2__)
+    __m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+
+    for( int k = 0; k < 3; ++k ) {
+        int e0 = triEval( e[k], x, y );
+        int a = e[k].A;
+        __m128i el = _mm_setr_epi32( e0, e0 + a, e0 + 2 * a, e0 + 3 * a );
+        __m128i eh = _mm_add_epi32( el, _mm_set1_epi32( 4 * a ) );
+        // a negative value in any edge sets that lane's sign bit
+        lo = _mm_or_si128( lo, el );
+        hi = _mm_or_si128( hi, eh );
+    }
+
+    unsigned out = _mm_movemask_ps( _mm_castsi128_ps( lo ) ) |
+                   ( _mm_movemask_ps( _mm_castsi128_ps( hi ) ) << 4 );
+    return ~out & 0xff;
+#else
+    unsigned mask = 0;
+    for( int i = 0; i < TRI_BLOCK; ++i ) {
+        if( ( triEval( e[0], x + i, y ) | triEval( e[1], x + i, y ) |
+              triEval( e[2], x + i, y ) ) >= 0 ) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+#endif
+}
+
+///
+// Does a coordinate lie on the 1/16 pixel grid?  (Scaling by a power
+// of two is exact, so this is too.)
+///
+static inline bool onTriGrid( float v )
+{
+    float s = v * TRI_SUBPIXEL;
+    return s == floorf( s );
+}
+
+///
+// Index of the lowest set bit of a nonzero mask
+///
+static inline int lowestBit( unsigned m )
+{
+#if defined(__GNUC__)
+    return __builtin_ctz( m );
+#else
+    int i = 0;
+    while( !( m & 1 ) ) {
+        m >>= 1;
+        ++i;
+    }
+    return i;
+#endif
+}
+
+///
+// Fill a triangle with the half-space (edge function) method
 //
-// @param n number of scanlines
-// @param C The Canvas to use
+// @param a, b, c - the vertices
+// @return false if the triangle is not one for this method
+///
+bool Rasterizer::fillTriangle( const Vertex &a, const Vertex &b,
+                               const Vertex &c )
+{
+    float xmin = min( a.x, min( b.x, c.x ) );
+    float xmax = max( a.x, max( b.x, c.x ) );
+    float ymin = min( a.y, min( b.y, c.y ) );
+    float ymax = max( a.y, max( b.y, c.y ) );
+
+    // too big (or not a number): leave it to the scanline fill
+    if( !( xmax - xmin <= TRI_MAX_EXTENT && ymax - ymin <= TRI_MAX_EXTENT &&
+           xmin >= -TRI_MAX_COORD && xmax <= TRI_MAX_COORD &&
+           ymin >= -TRI_MAX_COORD && ymax <= TRI_MAX_COORD ) ) {
+        return false;
+    }
+
+    // between grid points: so is that
+    if( !( onTriGrid( a.x ) && onTriGrid( a.y ) && onTriGrid( b.x ) &&
+           onTriGrid( b.y ) && onTriGrid( c.x ) && onTriGrid( c.y ) ) ) {
+        return false;
+    }
+
+    // pixel bounding box, clipped
+    int bx0 = max( (int) floorf( xmin ), clipX0 );
+    int bx1 = min( (int) ceilf( xmax ) + 1, clipX1 );
+    int by0 = max( (int) floorf( ymin ), clipY0 );
+    int by1 = min( (int) ceilf( ymax ) + 1, clipY1 );
+    if( bx0 >= bx1 || by0 >= by1 ) {
+        return true;
+    }
+
+    // subpixel grid coordinates, relative to the box corner
+    float ox = (float) bx0, oy = (float) by0;
+    long long px[3] = {
+        (long long) floorf( (a.x - ox) * TRI_SUBPIXEL + 0.5f ),
+        (long long) floorf( (b.x - ox) * TRI_SUBPIXEL + 0.5f ),
+        (long long) floorf( (c.x - ox) * TRI_SUBPIXEL + 0.5f )
+    };
+    long long py[3] = {
+        (long long) floorf( (a.y - oy) * TRI_SUBPIXEL + 0.5f ),
+        (long long) floorf( (b.y - oy) * TRI_SUBPIXEL + 0.5f ),
+        (long long) floorf( (c.y - oy) * TRI_SUBPIXEL + 0.5f )
+    };
+
+    long long area = (px[1] - px[0]) * (py[2] - py[0]) -
+                     (px[2] - px[0]) * (py[1] - py[0]);
+    if( area == 0 ) {
+        // degenerate; nothing to fill
+        return true;
+    }
+    if( area < 0 ) {
+        // make the winding counterclockwise
+        swap( px[1], px[2] );
+        swap( py[1], py[2] );
+    }
+
+    TriEdge e[3];
+    for( int k = 0; k < 3; ++k ) {
+        long long x0 = px[k], y0 = py[k];
+        long long dx = px[(k + 1) % 3] - x0, dy = py[(k + 1) % 3] - y0;
+
+        // E = dx * (Y - y0) - dy * (X - x0), with X = 16x, Y = 16y
+        e[k].A = (int) ( -dy * TRI_SUBPIXEL );
+        e[k].B = (int) ( dx * TRI_SUBPIXEL );
+        long long C = dy * x0 - dx * y0;
+
+        // left and bottom edges own the pixels lying exactly on them
+        bool inclusive = dy < 0 || ( dy == 0 && dx > 0 );
+        e[k].C = (int) ( inclusive ? C : C - 1 );
+    }
+
+    const int B = TRI_BLOCK;
+    int w = bx1 - bx0, h = by1 - by0;
+    int nbx = (w + B - 1) / B;
+
+    // the blocks of one row which are not entirely outside,
+    // with neighbouring fully-covered blocks merged together
+    blockRuns.clear();
+
+    for( int y0 = 0; y0 < h; y0 += B ) {
+        int rows = min( B, h - y0 );
+
+        // the extremes of a linear function over a block are at its
+        // corners, so each edge's smallest and largest value in a
+        // block is its value at the block origin plus a fixed offset
+        int eb[3], loOff[3], hiOff[3];
+        for( int k = 0; k < 3; ++k ) {
+            int dx = e[k].A * (B - 1), dy = e[k].B * (rows - 1);
+            eb[k] = triEval( e[k], 0, y0 );
+            loOff[k] = min( dx, 0 ) + min( dy, 0 );
+            hiOff[k] = max( dx, 0 ) + max( dy, 0 );
+        }
+
+        blockRuns.clear();
+        for( int j = 0; j < nbx; ++j ) {
+            int in = ( eb[0] + loOff[0] ) | ( eb[1] + loOff[1] ) |
+                     ( eb[2] + loOff[2] );
+            // outside if any edge is negative over the whole block;
+            // inside if no edge is negative anywhere in it
+            bool outside = ( eb[0] + hiOff[0] < 0 ) ||
+                           ( eb[1] + hiOff[1] < 0 ) ||
+                           ( eb[2] + hiOff[2] < 0 );
+            int cls = outside ? 0 : ( in >= 0 ? 2 : 1 );
+
+            for( int k = 0; k < 3; ++k ) {
+                eb[k] += e[k].A * B;
+            }
+
+            if( cls == 0 ) {
+                continue;
+            }
+            if( cls == 2 && !blockRuns.empty() && blockRuns.back().full &&
+                blockRuns.back().last == j - 1 ) {
+                blockRuns.back().last = j;
+                continue;
+            }
+            BlockRun r = { j, j, cls == 2 };
+            blockRuns.push_back( r );
+        }
+
+        // walk each scanline across the row, joining the
+        // covered pixels into runs
+        for( int y = y0; y < y0 + rows; ++y ) {
+            int runStart = 0;
+            bool inRun = false;
+            int prevEnd = -1;
+
+            for( size_t r = 0; r < blockRuns.size(); ++r ) {
+                const BlockRun &br = blockRuns[r];
+
+                // skipped over outside blocks?  end any open run
+                if( inRun && br.first != prevEnd + 1 ) {
+                    emitSpan( by0 + y, bx0 + runStart,
+                              bx0 + (prevEnd + 1) * B );
+                    inRun = false;
+                }
+                prevEnd = br.last;
+
+                if( br.full ) {
+                    if( !inRun ) {
+                        runStart = br.first * B;
+                        inRun = true;
+                    }
+                    continue;
+                }
+
+                int x0 = br.first * B;
+                unsigned mask = triRowMask( e, x0, y );
+
+                // find where runs end and start within this block
+                int i = 0;
+                for( ;; ) {
+                    if( inRun ) {
+                        unsigned gaps = ~mask & ( 0xffu << i ) & 0xffu;
+                        if( gaps == 0 ) {
+                            break;
+                        }
+                        i = lowestBit( gaps );
+                        emitSpan( by0 + y, bx0 + runStart, bx0 + x0 + i );
+                        inRun = false;
+                    }
+                    unsigned set = mask & ( 0xffu << i ) & 0xffu;
+                    if( set == 0 ) {
+                        break;
+                    }
+                    i = lowestBit( set );
+                    runStart = x0 + i;
+                    inRun = true;
+                }
+            }
+
+            if( inRun ) {
+                emitSpan( by0 + y, bx0 + runStart,
+                          bx0 + (prevEnd + 1) * B );
+            }
+        }
+    }
+
+    return true;
+}
+
+///
+// Draw a batch of filled triangles
+//
+// Triangle i has vertices v[3i], v[3i+1], and v[3i+2].
+//
+// @param count - number of triangles
+// @param v     - array of 3 * count vertices
+///
+void Rasterizer::drawTriangles( int count, const Vertex v[] )
+{
+    if( clipY0 >= clipY1 ) {
+        return;
+    }
+
+    for( int i = 0; i < count; ++i ) {
+        const Vertex *t = &v[3 * i];
+        if( antialias || depthTest ) {
+            fillPolygon( 3, t );
+        } else if( !fillTriangle( t[0], t[1], t[2] ) ) {
+            fillPolygon( 3, t, false );
+        }
+    }
+}
+
+///
+// Draw a batch of filled polygons, each in its own color
+//
+// @param count - number of polygons
+// @param x, y  - vertex coordinates
+// @param first - index of each polygon's first vertex
+// @param n     - number of vertices in each polygon
+// @param c     - the color of each polygon, or NULL to draw
+//                them all in the canvas's current color
 ///
+void Rasterizer::drawPolygons( int count, const float x[], const float y[],
+                               const int first[], const int n[],
+                               const Color c[] )
+{
+    if( clipY0 >= clipY1 || clipX0 >= clipX1 ) {
+        return;
+    }
+
+    useFill = c != 0;
+
+    for( int i = 0; i < count; ++i ) {
+        int m = n[i];
+        if( m < 3 ) {
+            continue;
+        }
+
+        const float *px = x + first[i], *py = y + first[i];
+
+        // bounding box, straight from the coordinate arrays
+        float xmin = px[0], xmax = px[0], ymin = py[0], ymax = py[0];
+        for( int k = 1; k < m; ++k ) {
+            xmin = px[k] < xmin ? px[k] : xmin;
+            xmax = px[k] > xmax ? px[k] : xmax;
+            ymin = py[k] < ymin ? py[k] : ymin;
+            ymax = py[k] > ymax ? py[k] : ymax;
+        }
+        if( unseenBox( xmin, ymin, xmax, ymax ) ) {
+            continue;
+        }
+
+        if( (int) batch.size() < m ) {
+            Vertex zero = { 0.0f, 0.0f, 0.0f, 1.0f };
+            batch.resize( m, zero );
+        }
+        for( int k = 0; k < m; ++k ) {
+            batch[k].x = px[k];
+            batch[k].y = py[k];
+        }
+
+        if( c ) {
+            fill = c[i];
+        }
+        drawPolygon( m, &batch[0] );
+    }
 
+    useFill = false;
+}
 
+///
+// Anti-aliased filling
+//
+// Each pixel (x,y) is the unit square centered on (x,y).  Every edge
+// is cut at row and column boundaries, and each piece adds its signed
+// height to a cell: the part of the height to the right of the piece
+// goes to the cell the piece is in, the rest to the next cell.  The
+// running sum of the cells along a row is then the (signed) area of
+// the polygon in each pixel, and stays constant between cells, so
+// interior runs come out as ordinary solid spans and the work done
+// grows with the perimeter rather than the area.
+///
 
-Rasterizer::Rasterizer( int n, Canvas &canvas ) : n_scanlines(n), C(canvas)
+///
+// Add to the coverage of one pixel row
+//
+// @param y     - the row
+// @param xa    - where the edge piece crossing the row starts
+// @param xb    - where it ends
+// @param h     - its signed height
+// @param left  - first visible column
+// @param right - one past the last visible column
+///
+void Rasterizer::addCoverageRow( int y, float xa, float xb, float h,
+                                 int left, int right )
 {
+    // the contribution doesn't depend on which way the piece runs
+    if( xa > xb ) {
+        swap( xa, xb );
+    }
+
+    float L = (float) left, R = (float) right;
+
+    // anything to the left of the visible columns covers all of them
+    if( xb <= L ) {
+        Cell cell = { y, left, h };
+        cells.push_back( cell );
+        return;
+    }
+    if( xa >= R ) {
+        return;
+    }
+
+    // from here on xa >= left >= 0, so truncating is flooring
+
+    if( xa == xb ) {
+        int i = (int) xa;
+        float m = xa - i;
+        Cell c0 = { y, i, h * (1.0f - m) }, c1 = { y, i + 1, h * m };
+        cells.push_back( c0 );
+        cells.push_back( c1 );
+        return;
+    }
+
+    // height per unit of x
+    float k = h / (xb - xa);
+
+    if( xa < L ) {
+        Cell cell = { y, left, k * (L - xa) };
+        cells.push_back( cell );
+        xa = L;
+    }
+    if( xb > R ) {
+        xb = R;
+    }
+
+    // walk the columns; what a piece leaves for the next column
+    // is carried along and added with that column's own share
+    int i = (int) xa;
+    float carry = 0.0f;
+
+    for( float xs = xa; xs < xb; ++i ) {
+        float xe = min( (float) (i + 1), xb );
+        float dh = k * (xe - xs);
+        float m = (xs + xe) * 0.5f - i;
+
+        Cell cell = { y, i, carry + dh * (1.0f - m) };
+        cells.push_back( cell );
+        carry = dh * m;
+        xs = xe;
+    }
+
+    Cell cell = { y, i, carry };
+    cells.push_back( cell );
 }
 
 ///
-// Draw a filled polygon.
+// Add the coverage of the edge (v0,v1)
 //
-// Implementation should use the scan-line polygon fill algorithm
-// discussed in class.
+// @param v0    - first endpoint
+// @param v1    - second endpoint
+// @param left  - first visible column
+// @param right - one past the last visible column
+///
+void Rasterizer::addCoverage( const Vertex &v0, const Vertex &v1,
+                              int left, int right )
+{
+    // horizontal edges cover nothing
+    if( v0.y == v1.y ) {
+        return;
+    }
+
+    int dir = v0.y < v1.y ? 1 : -1;
+    const Vertex &lo = dir > 0 ? v0 : v1;
+    const Vertex &hi = dir > 0 ? v1 : v0;
+
+    // shift by half a pixel, so that pixel (x,y) is [x,x+1]x[y,y+1]
+    float xLo = lo.x + 0.5f, yLo = lo.y + 0.5f;
+    float yHi = hi.y + 0.5f;
+    float dxdy = (hi.x - lo.x) / (hi.y - lo.y);
+
+    int y0 = max( (int) floorf( yLo ), clipY0 );
+    int y1 = min( (int) ceilf( yHi ), clipY1 );
+
+    for( int y = y0; y < y1; ++y ) {
+        float ya = max( yLo, (float) y );
+        float yb = min( yHi, (float) (y + 1) );
+        if( yb <= ya ) {
+            continue;
+        }
+
+        addCoverageRow( y, xLo + (ya - yLo) * dxdy, xLo + (yb - yLo) * dxdy,
+                        (yb - ya) * dir, left, right );
+    }
+}
+
+///
+// Convert accumulated signed area to an alpha value (0 to 255)
+///
+template<FillRule rule>
+static inline int coverageAlpha( float area )
+{
+    float a = fabsf( area );
+
+    if( rule == FILL_EVEN_ODD ) {
+        // a winding of 2 is outside again
+        if( a > 1.0f ) {
+            a -= 2.0f * floorf( a * 0.5f );
+            if( a > 1.0f ) {
+                a = 2.0f - a;
+            }
+        }
+    } else if( a > 1.0f ) {
+        a = 1.0f;
+    }
+
+    return (int) (a * 255.0f + 0.5f);
+}
+
+///
+// Hand a run of equally covered pixels to the canvas
 //
-// The polygon has n distinct vertices.  The coordinates of the vertices
-// making up the polygon are supplied in the 'v' array parameter, such
-// that the ith vertex is in v[i].
+// @param y     - the scanline
+// @param x0    - first pixel in the run
+// @param x1    - one past the last pixel in the run
+// @param alpha - coverage, from 0 to 255
+///
+void Rasterizer::emitCoverage( int y, int x0, int x1, int alpha )
+{
+    if( alpha == 0 ) {
+        return;
+    }
+    if( alpha == 255 ) {
+        emitSpan( y, x0, x1 );
+        return;
+    }
+
+    x0 = max( x0, clipX0 );
+    x1 = min( x1, clipX1 );
+    if( x0 >= x1 ) {
+        return;
+    }
+
+    putSpan( y, x0, x1, alpha );
+}
+
+///
+// Sum the coverage cells along each row, and emit the pixels
 //
-// You are to add the implementation here using only calls to the
-// addPixel() function.
+// @param left  - first visible column
+// @param right - one past the last visible column
+///
+template<FillRule rule>
+void Rasterizer::sweepCoverage( int left, int right )
+{
+    // bucket the cells by row (they were made edge by edge), then
+    // sort each row, which only holds a handful of them, by column
+    int y0 = clipY1, y1 = clipY0;
+    for( size_t i = 0; i < cells.size(); ++i ) {
+        y0 = min( y0, cells[i].y );
+        y1 = max( y1, cells[i].y + 1 );
+    }
+
+    rowStart.assign( y1 - y0 + 1, 0 );
+    for( size_t i = 0; i < cells.size(); ++i ) {
+        ++rowStart[cells[i].y - y0 + 1];
+    }
+    for( size_t r = 1; r < rowStart.size(); ++r ) {
+        rowStart[r] += rowStart[r - 1];
+    }
+
+    rowCells.resize( cells.size() );
+    for( size_t i = 0; i < cells.size(); ++i ) {
+        rowCells[rowStart[cells[i].y - y0]++] = cells[i];
+    }
+
+    size_t k = 0, n = rowCells.size();
+
+    while( k < n ) {
+        int y = rowCells[k].y;
+        size_t end = k;
+        while( end < n && rowCells[end].y == y ) {
+            ++end;
+        }
+        sort( rowCells.begin() + k, rowCells.begin() + end,
+              []( const Cell &a, const Cell &b ) {
+                  return a.x < b.x;
+              } );
+
+        float area = 0.0f;
+
+        // pending run of equally covered pixels
+        int runX0 = left, runX1 = left, runAlpha = 0;
+
+        while( k < end ) {
+            int x = rowCells[k].x;
+            do {
+                area += rowCells[k].cover;
+                ++k;
+            } while( k < end && rowCells[k].x == x );
+
+            // the coverage holds until the next cell in the row
+            int next = k < end ? rowCells[k].x : right;
+            int alpha = coverageAlpha<rule>( area );
+
+            if( alpha == runAlpha && x == runX1 ) {
+                runX1 = next;
+            } else {
+                emitCoverage( y, runX0, runX1, runAlpha );
+                runX0 = x;
+                runX1 = next;
+                runAlpha = alpha;
+            }
+        }
+
+        emitCoverage( y, runX0, runX1, runAlpha );
+    }
+}
+
+///
+// Fill a polygon with anti-aliased edges
 //
 // @param n - number of vertices
 // @param v - array of vertices
 ///
+void Rasterizer::fillCoverage( int n, const Vertex v[] )
+{
+    int left = clipX0, right = clipX1;
+    if( left >= right ) {
+        return;
+    }
+
+    cells.clear();
+    for( int i = 0; i < n; ++i ) {
+        addCoverage( v[i], v[(i + 1) % n], left, right );
+    }
+    if( cells.empty() ) {
+        return;
+    }
+
+    if( fillRule == FILL_NONZERO ) {
+        sweepCoverage<FILL_NONZERO>( left, right );
+    } else {
+        sweepCoverage<FILL_EVEN_ODD>( left, right );
+    }
+}
+
+///
+// Paths
+//
+// A Bezier curve of degree d, evaluated at n evenly spaced values of
+// its parameter, strays at most
+//
+//     d (d - 1) / 8 * M / n^2
+//
+// from the straight segments between them, where M is the longest of
+// its control polygon's second differences |P[i] - 2 P[i+1] + P[i+2]|
+// (Wang's formula).  Solving for n gives the fewest segments within
+// the tolerance, up to PATH_MAX_SEGMENTS.
+///
+
+#define PATH_MAX_SEGMENTS   1024
+
+///
+// Add one flattened path segment to the edge table being built
+//
+// @param x0, y0 - first endpoint
+// @param x1, y1 - second endpoint
+///
+void Rasterizer::pathEdge( float x0, float y0, float x1, float y1 )
+{
+    float gx0 = -GUARD_BAND, gx1 = C.getWidth() + GUARD_BAND;
+    float gy0 = -GUARD_BAND, gy1 = n_scanlines + GUARD_BAND;
 
+    if( y0 == y1 ) {
+        return;
+    }
 
+    Vertex a = { x0, y0, 0.0f, 1.0f };
+    Vertex b = { x1, y1, 0.0f, 1.0f };
 
-void printVertices(int n, const Vertex v[]){
-	for(int i=0;i<n;i++){
-		cout<<"("<<v[i].x<<","<<v[i].y<<")";
-		cout<<"\n";
-	}	
+    if( min( x0, x1 ) >= gx0 && max( x0, x1 ) <= gx1 &&
+        min( y0, y1 ) >= gy0 && max( y0, y1 ) <= gy1 ) {
+        pathClip( a, b, 4 );
+    } else {
+        pathClip( a, b, 0 );
+    }
 }
 
-void createEdges(int n, int x[], int y[], bucket *B){
-	int i;
-	double m;
+///
+// Clip a path segment to the guard band, one side at a time
+//
+// The sides are taken in the order clipToGuardBand() takes them, and
+// each crossing point is found the way clipSide() finds it, so a
+// closed path of straight segments is cut exactly as the polygon with
+// the same vertices would be.
+//
+// @param a, b - the segment's endpoints
+// @param side - the first side left to clip to: 0 and 1 for the left
+//               and right ones, 2 and 3 for the top and bottom ones;
+//               4 adds the segment to the edge table
+///
+void Rasterizer::pathClip( const Vertex &a, const Vertex &b, int side )
+{
+    if( side == 4 ) {
+        if( depthTest ) {
+            Color none = { 0.0f, 0.0f, 0.0f, 0.0f };
+            addShadedEdge( a, none, b, none );
+        } else if( antialias ) {
+            addCoverage( a, b, clipX0, clipX1 );
+        } else {
+            addEdge( a, b );
+        }
+        return;
+    }
+
+    int axis = side / 2;
+    bool above = side % 2 == 0;
+    float far = axis ? n_scanlines : C.getWidth();
+    float bound = above ? -GUARD_BAND : far + GUARD_BAND;
+
+    float ca = axis ? a.y : a.x;
+    float cb = axis ? b.y : b.x;
+    bool ina = above ? ca >= bound : ca <= bound;
+    bool inb = above ? cb >= bound : cb <= bound;
+
+    if( ina && inb ) {
+        pathClip( a, b, side + 1 );
+        return;
+    }
 
-	for (i=0;i<n;i++){
-		if(y[i] > y[(i+1)%n]){
-			B[i].yMax = y[i];
-			B[i].yMin = y[(i+1)%n];
-			B[i].x = x[(i+1)%n];
-			B[i].invSlope = static_cast<float>(x[(i+1)%n]-x[i])/(y[(i+1)%n]-y[i]);
-		}
-		else if(y[i] < y[(i+1)%n]){
-			B[i].yMax = y[(i+1)%n];
-			B[i].yMin = y[i];
-			B[i].x = x[i];
-			B[i].invSlope = static_cast<float>(x[(i+1)%n]-x[i])/(y[(i+1)%n]-y[i]);
-		}
-		else
-			B[i].invSlope = INF;
-			
-	}
+    // the part inside goes on to the next side; the rest is cut off
+    // (above and below) or slid onto the side (left and right)
+    if( ina == inb ) {
+        if( axis == 0 ) {
+            Vertex u = a, w = b;
+            u.x = w.x = bound;
+            pathClip( u, w, side + 1 );
+        }
+        return;
+    }
+
+    float t;
+    Vertex p = crossing( a, b, axis, bound, t );
+    if( ina ) {
+        pathClip( a, p, side + 1 );
+        if( axis == 0 ) {
+            Vertex w = b;
+            w.x = bound;
+            pathClip( p, w, side + 1 );
+        }
+    } else {
+        if( axis == 0 ) {
+            Vertex u = a;
+            u.x = bound;
+            pathClip( u, p, side + 1 );
+        }
+        pathClip( p, b, side + 1 );
+    }
 }
 
-void sort(bucket *B, int n){
-	int i,j;
-	bucket key;
-	for(i=1;i<n;i++){
-		key = B[i];
-		j = i-1;
-		while(j>=0 && B[j].yMax > key.yMax || B[j].yMin > key.yMin || B[j].x > key.x){
-			B[j+1] = B[j];
-			j --;
-		}
-		B[j+1] = key;
-	}
+///
+// Flatten a Bezier curve into path segments
+//
+// @param p      - x,y pairs of the start, control, and end points
+// @param degree - 2 for a quadratic curve, 3 for a cubic one
+///
+void Rasterizer::pathCurve( const float p[], int degree )
+{
+    float x0 = p[0], y0 = p[1];
+    float x1 = p[2 * degree], y1 = p[2 * degree + 1];
+
+    // the curve lies within its control points' bounding box; if
+    // that is out of sight, the straight line between the ends gives
+    // every visible pixel the same winding
+    float xmin = x0, xmax = x0, ymin = y0, ymax = y0;
+    for( int i = 1; i <= degree; ++i ) {
+        xmin = min( xmin, p[2 * i] );
+        xmax = max( xmax, p[2 * i] );
+        ymin = min( ymin, p[2 * i + 1] );
+        ymax = max( ymax, p[2 * i + 1] );
+    }
+    if( xmax < clipX0 - 1 || xmin > clipX1 + 1 ||
+        ymax < clipY0 - 1 || ymin > clipY1 + 1 ) {
+        pathEdge( x0, y0, x1, y1 );
+        return;
+    }
+
+    float m = 0.0f;
+    for( int i = 0; i + 2 <= degree; ++i ) {
+        float ddx = p[2 * i] - 2.0f * p[2 * i + 2] + p[2 * i + 4];
+        float ddy = p[2 * i + 1] - 2.0f * p[2 * i + 3] + p[2 * i + 5];
+        m = max( m, ddx * ddx + ddy * ddy );
+    }
+
+    float k = degree * (degree - 1) / 8.0f;
+    float segs = ceilf( sqrtf( k * sqrtf( m ) / tolerance ) );
+    int n = segs < PATH_MAX_SEGMENTS ? max( (int) segs, 1 )
+                                     : PATH_MAX_SEGMENTS;
+
+    float h = 1.0f / n;
+    float xa = x0, ya = y0;
+    for( int i = 1; i < n; ++i ) {
+        float s = i * h, r = 1.0f - s;
+        float xb, yb;
+        if( degree == 2 ) {
+            float b0 = r * r, b1 = 2.0f * r * s, b2 = s * s;
+            xb = b0 * p[0] + b1 * p[2] + b2 * p[4];
+            yb = b0 * p[1] + b1 * p[3] + b2 * p[5];
+        } else {
+            float b0 = r * r * r, b1 = 3.0f * r * r * s;
+            float b2 = 3.0f * r * s * s, b3 = s * s * s;
+            xb = b0 * p[0] + b1 * p[2] + b2 * p[4] + b3 * p[6];
+            yb = b0 * p[1] + b1 * p[3] + b2 * p[5] + b3 * p[7];
+        }
+        pathEdge( xa, ya, xb, yb );
+        xa = xb;
+        ya = yb;
+    }
+
+    // end exactly where the next segment starts
+    pathEdge( xa, ya, x1, y1 );
 }
 
-void drawPolygon(bucket *B, int n){
-	
+///
+// Draw a filled path
+//
+// The path's segments are streamed into the same tables a polygon's
+// edges go into:  the coverage cells when anti-aliasing, and the
+// scanline edge table otherwise (with depth, when testing it).
+//
+// @param path - the path
+///
+void Rasterizer::drawPath( const Path &path )
+{
+    const vector<PathVerb> &verbs = path.getVerbs();
+    const vector<float> &co = path.getCoords();
+    if( verbs.empty() ) {
+        return;
+    }
+
+    float bx0, by0, bx1, by1;
+    path.getBounds( bx0, by0, bx1, by1 );
+    if( unseenBox( bx0, by0, bx1, by1 ) ) {
+        return;
+    }
+
+    bool cover = antialias && !depthTest;
+    if( cover ) {
+        cells.clear();
+    } else {
+        edges.clear();
+        shades.clear();
+        yLo = clipY1;
+        yHi = 0;
+    }
+
+    // start of the current subpath, and the current point
+    float sx = 0.0f, sy = 0.0f, cx = 0.0f, cy = 0.0f;
+    float curve[8];
+    size_t k = 0;
+
+    for( size_t i = 0; i < verbs.size(); ++i ) {
+        switch( verbs[i] ) {
+        case PATH_MOVE:
+            pathEdge( cx, cy, sx, sy );
+            sx = cx = co[k];
+            sy = cy = co[k + 1];
+            k += 2;
+            break;
+        case PATH_LINE:
+            pathEdge( cx, cy, co[k], co[k + 1] );
+            cx = co[k];
+            cy = co[k + 1];
+            k += 2;
+            break;
+        case PATH_QUAD:
+        case PATH_CUBIC: {
+            int degree = verbs[i] == PATH_QUAD ? 2 : 3;
+            curve[0] = cx;
+            curve[1] = cy;
+            for( int j = 0; j < 2 * degree; ++j ) {
+                curve[2 + j] = co[k + j];
+            }
+            pathCurve( curve, degree );
+            k += 2 * degree;
+            cx = co[k - 2];
+            cy = co[k - 1];
+            break;
+        }
+        case PATH_CLOSE:
+            pathEdge( cx, cy, sx, sy );
+            cx = sx;
+            cy = sy;
+            break;
+        }
+    }
+    pathEdge( cx, cy, sx, sy );
+
+    if( cover ) {
+        if( cells.empty() ) {
+            return;
+        }
+        if( fillRule == FILL_NONZERO ) {
+            sweepCoverage<FILL_NONZERO>( clipX0, clipX1 );
+        } else {
+            sweepCoverage<FILL_EVEN_ODD>( clipX0, clipX1 );
+        }
+        return;
+    }
+
+    if( edges.empty() ) {
+        return;
+    }
+
+    if( depthTest ) {
+        shadeMode = SHADE_FLAT;
+        if( fillRule == FILL_NONZERO ) {
+            fillEdges<FILL_NONZERO, true>();
+        } else {
+            fillEdges<FILL_EVEN_ODD, true>();
+        }
+        shadeMode = SHADE_COLOR;
+        settleTiles();
+    } else if( fillRule == FILL_NONZERO ) {
+        fillEdges<FILL_NONZERO, false>();
+    } else {
+        fillEdges<FILL_EVEN_ODD, false>();
+    }
 }
 
-void Rasterizer::drawPolygon( int n, const Vertex v[] )
+///
+// Draw a filled path in the specified color
+//
+// @param path - the path
+// @param c    - the fill color
+///
+void Rasterizer::drawPath( const Path &path, Color c )
 {
-    bucket edgeTable[n];
-
-	int x[n],y[n];
-	for(int i=0;i<n;i++){
-		x[i] = v[i].x;
-		y[i] = v[i].y;
-	}
-
-	createEdges(n,x,y, edgeTable);
-	sort(edgeTable, n);
-	cout<<"Drawing"<<endl;
-	int i;
-	int parity = 0; // 0: even; 1: odd
-	int scanLine = edgeTable[1].yMin;
-	int count = 0;
-	for(i=1;i<n;i++){
-		if(edgeTable[i].yMin == scanLine){
-			count++;
-		}
-	}
-	bucket *AEL = nullptr;
-
-	AEL = new bucket[count];
-	int k = 0;
-	for(i=1;i<n;i++){
-		if(edgeTable[i].yMin == scanLine){
-			AEL[k].yMin = edgeTable[i].yMin;
-			AEL[k].yMax = edgeTable[i].yMax;
-			AEL[k].x = edgeTable[i].x + edgeTable[i].invSlope;
-			AEL[k].invSlope = edgeTable[i].invSlope;
-			k++;
-		}
-	}	
-
-	sort(AEL, count);
-	for(int i=0;i<count;i++)
-		cout<<AEL[i].yMin<<","<<AEL[i].yMax<<","<<AEL[i].x<<","<<AEL[i].invSlope<<"\n";
-
-
-	Vertex p = {AEL[0].x,AEl[0].yMin}
-	addPixel(p);
-
-	delete[] AEL;
+    useFill = true;
+    fill = c;
+
+    drawPath( path );
+
+    useFill = false;
 }
@@ -0,0 +1,326 @@
+///
+//  Scene.cpp
+//
+//  Retained scene of filled polygons, redrawn incrementally.
+//
+//  Dirty rectangles are merged whenever they overlap or touch, so
+//  that no pixel is redrawn twice; the polygons overlapping each
+//  merged rectangle are then redrawn, in order, clipped to it.
+///
+
+#include <cmath>
+#include <algorithm>
+
+#include "Scene.h"
+
+using namespace std;
+
+///
+// Do two rectangles overlap?
+///
+static inline bool overlaps( const Rect &a, const Rect &b )
+{
+    return a.x0 < b.x1 && b.x0 < a.x1 && a.y0 < b.y1 && b.y0 < a.y1;
+}
+
+///
+// Do two rectangles overlap or share an edge?
+///
+static inline bool touches( const Rect &a, const Rect &b )
+{
+    return a.x0 <= b.x1 && b.x0 <= a.x1 && a.y0 <= b.y1 && b.y0 <= a.y1;
+}
+
+///
+// Constructor
+//
+// @param rast - the Rasterizer to draw with
+///
+Scene::Scene( Rasterizer &rast ) : R(rast), frontToBack(false),
+    drawnFirst(0), drawnLast(0)
+{
+    Rect all = { 0, 0, R.C.getWidth(), R.C.getHeight() };
+    markDirty( all );
+}
+
+///
+// Find the pixels a polygon can touch
+//
+// A pixel is filled if its center is inside the polygon, or, when
+// anti-aliasing, if the polygon covers any of it; either way it is
+// within a pixel of the polygon's bounding box.
+//
+// @param item - the polygon
+///
+void Scene::findBox( Item &item )
+{
+    float w = (float) R.C.getWidth(), h = (float) R.C.getHeight();
+
+    float xmin = item.verts[0].x, xmax = xmin;
+    float ymin = item.verts[0].y, ymax = ymin;
+    for( size_t i = 1; i < item.verts.size(); ++i ) {
+        xmin = min( xmin, item.verts[i].x );
+        xmax = max( xmax, item.verts[i].x );
+        ymin = min( ymin, item.verts[i].y );
+        ymax = max( ymax, item.verts[i].y );
+    }
+
+    // keep far off-canvas coordinates in range of an int
+    xmin = min( max( xmin, -1.0f ), w + 1.0f );
+    xmax = min( max( xmax, -1.0f ), w + 1.0f );
+    ymin = min( max( ymin, -1.0f ), h + 1.0f );
+    ymax = min( max( ymax, -1.0f ), h + 1.0f );
+
+    item.box.x0 = max( (int) floorf( xmin ) - 1, 0 );
+    item.box.y0 = max( (int) floorf( ymin ) - 1, 0 );
+    item.box.x1 = min( (int) ceilf( xmax ) + 1, (int) w );
+    item.box.y1 = min( (int) ceilf( ymax ) + 1, (int) h );
+}
+
+///
+// Mark a rectangle as needing to be redrawn
+//
+// @param r - the rectangle
+///
+void Scene::markDirty( Rect r )
+{
+    if( r.x0 < r.x1 && r.y0 < r.y1 ) {
+        pending.push_back( r );
+    }
+}
+
+///
+// Is 'id' a polygon still in the scene?
+///
+bool Scene::valid( int id )
+{
+    return id >= 0 && id < (int) items.size() && items[id].live;
+}
+
+///
+// Add a polygon in front of all the others
+//
+// @param n    - number of vertices
+// @param v    - array of vertices
+// @param c    - the fill color
+// @param rule - the fill rule
+// @return the polygon's id, or -1 if it has fewer than 3 vertices
+///
+int Scene::add( int n, const Vertex v[], Color c, FillRule rule )
+{
+    if( n < 3 ) {
+        return -1;
+    }
+
+    items.push_back( Item() );
+    Item &item = items.back();
+
+    item.verts.assign( v, v + n );
+    item.color = c;
+    item.rule = rule;
+    item.live = true;
+    findBox( item );
+
+    markDirty( item.box );
+    return (int) items.size() - 1;
+}
+
+///
+// Move a polygon
+//
+// @param id     - the polygon
+// @param dx, dy - how far to move it
+///
+void Scene::move( int id, float dx, float dy )
+{
+    if( !valid( id ) ) {
+        return;
+    }
+
+    Item &item = items[id];
+    markDirty( item.box );
+
+    for( size_t i = 0; i < item.verts.size(); ++i ) {
+        item.verts[i].x += dx;
+        item.verts[i].y += dy;
+    }
+    findBox( item );
+
+    markDirty( item.box );
+}
+
+///
+// Replace a polygon's vertices
+//
+// @param id - the polygon
+// @param n  - number of vertices
+// @param v  - array of vertices
+///
+void Scene::reshape( int id, int n, const Vertex v[] )
+{
+    if( !valid( id ) || n < 3 ) {
+        return;
+    }
+
+    Item &item = items[id];
+    markDirty( item.box );
+
+    item.verts.assign( v, v + n );
+    findBox( item );
+
+    markDirty( item.box );
+}
+
+///
+// Change a polygon's color
+//
+// @param id - the polygon
+// @param c  - the new fill color
+///
+void Scene::recolor( int id, Color c )
+{
+    if( !valid( id ) ) {
+        return;
+    }
+
+    Item &item = items[id];
+    if( c.r == item.color.r && c.g == item.color.g &&
+        c.b == item.color.b && c.a == item.color.a ) {
+        return;
+    }
+
+    item.color = c;
+    markDirty( item.box );
+}
+
+///
+// Remove a polygon (its id is not reused)
+//
+// @param id - the polygon
+///
+void Scene::remove( int id )
+{
+    if( !valid( id ) ) {
+        return;
+    }
+
+    Item &item = items[id];
+    markDirty( item.box );
+
+    item.live = false;
+    vector<Vertex>().swap( item.verts );
+}
+
+///
+// Redraw everything which has changed since the last update()
+//
+// The Rasterizer is left without a clipping rectangle, and with
+// the fill rule it had before.
+//
+// @return the number of rectangles redrawn
+///
+int Scene::update( void )
+{
+    updated.clear();
+
+    // merge the pending rectangles until none overlap or touch
+    for( size_t i = 0; i < pending.size(); ++i ) {
+        Rect r = pending[i];
+
+        bool grew = true;
+        while( grew ) {
+            grew = false;
+            for( size_t k = 0; k < updated.size(); ++k ) {
+                if( touches( r, updated[k] ) ) {
+                    r.x0 = min( r.x0, updated[k].x0 );
+                    r.y0 = min( r.y0, updated[k].y0 );
+                    r.x1 = max( r.x1, updated[k].x1 );
+                    r.y1 = max( r.y1, updated[k].y1 );
+                    updated[k] = updated.back();
+                    updated.pop_back();
+                    grew = true;
+                    break;
+                }
+            }
+        }
+
+        updated.push_back( r );
+    }
+    pending.clear();
+
+    if( updated.empty() ) {
+        return 0;
+    }
+
+    // without a framebuffer, pixels can't be cleared from a region,
+    // so the scene's own pixels come out and everything is drawn again
+    // (if they are still there to be taken)
+    bool dense = R.C.hasFramebuffer();
+    if( !dense ) {
+        Rect all = { 0, 0, R.C.getWidth(), R.C.getHeight() };
+        updated.assign( 1, all );
+        if( R.C.numVertices() >= drawnLast ) {
+            R.C.removePixels( drawnFirst, drawnLast );
+        }
+        drawnFirst = R.C.numVertices();
+    }
+
+    FillRule rule = R.getFillRule();
+
+    // the rectangles don't overlap, so one coverage mask does for all
+    bool reverse = frontToBack && !R.getAntialias();
+    if( reverse ) {
+        R.setOcclusion( true );
+    }
+
+    int count = (int) items.size();
+
+    for( size_t k = 0; k < updated.size(); ++k ) {
+        const Rect &r = updated[k];
+
+        R.C.clearRect( r );
+        R.setClip( r.x0, r.y0, r.x1, r.y1 );
+
+        for( int j = 0; j < count; ++j ) {
+            const Item &item = items[reverse ? count - 1 - j : j];
+            if( item.live && overlaps( item.box, r ) ) {
+                R.setFillRule( item.rule );
+                R.drawPolygon( (int) item.verts.size(), &item.verts[0],
+                               item.color );
+            }
+        }
+    }
+
+    if( reverse ) {
+        R.setOcclusion( false );
+    }
+
+    if( !dense ) {
+        drawnLast = R.C.numVertices();
+    }
+
+    R.resetClip();
+    R.setFillRule( rule );
+
+    return (int) updated.size();
+}
+
+///
+// The rectangles redrawn by the last update()
+//
+// @return the rectangles
+///
+const vector<Rect> &Scene::dirtyRects( void )
+{
+    return updated;
+}
+
+///
+// Draw front to back from now on, or not
+//
+// @param on - true to draw front to back
+///
+void Scene::setFrontToBack( bool on )
+{
+    frontToBack = on;
+}
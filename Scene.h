@@ -0,0 +1,174 @@
+///
+//  Scene.h
+//
+//  Retained scene of filled polygons, redrawn incrementally.
+//
+//  The scene remembers every polygon it has been given, in drawing
+//  order, along with the rectangle of pixels each one can touch.
+//  Adding, moving, recoloring, or removing a polygon only marks the
+//  affected rectangles dirty; update() then clears just those
+//  rectangles of the canvas and redraws, clipped to them, the
+//  polygons which overlap them.  The result is the same as clearing
+//  the canvas and drawing every polygon again.
+//
+//  The rectangles redrawn by the last update() are available through
+//  dirtyRects(), so that the upload to the GPU can be limited to them
+//  as well (see BufferSet::updateTexture()).
+//
+//  Partial redraws need a Canvas with a dense framebuffer (see
+//  Canvas::useFramebuffer()).  With any other Canvas, update() takes
+//  the pixels of the scene's last drawing back out of the canvas and
+//  draws the whole scene again; pixels drawn by anyone else are kept
+//  (though any drawn after the scene now lie beneath it).  The canvas
+//  should then not be cleared or compacted (Canvas::compactPixels())
+//  between updates, or the scene's pixels can no longer be found.
+//
+//  Optionally, the polygons are drawn front to back instead (see
+//  Rasterizer::setOcclusion()), so that pixels hidden by polygons
+//  in front are never written.
+///
+
+#ifndef _SCENE_H_
+#define _SCENE_H_
+
+#include <vector>
+
+#include "Types.h"
+#include "Canvas.h"
+#include "Rasterizer.h"
+
+class Scene {
+
+    ///
+    // A polygon in the scene
+    ///
+    struct Item {
+        std::vector<Vertex> verts;  // its vertices
+        Color color;                // fill color
+        FillRule rule;              // fill rule
+        Rect box;                   // pixels it can touch
+        bool live;                  // false once removed
+    };
+
+    // the polygons, in drawing order; an id is an index in here
+    std::vector<Item> items;
+
+    // regions waiting to be redrawn
+    std::vector<Rect> pending;
+
+    // regions redrawn by the last update()
+    std::vector<Rect> updated;
+
+    // the engine used for drawing
+    Rasterizer &R;
+
+    // draw front to back?
+    bool frontToBack;
+
+    // where the last drawing of the whole scene went in the pixel
+    // data of a canvas without a framebuffer (first, one past last)
+    int drawnFirst, drawnLast;
+
+    ///
+    // Find the pixels a polygon can touch
+    //
+    // @param item - the polygon
+    ///
+    void findBox( Item &item );
+
+    ///
+    // Mark a rectangle as needing to be redrawn
+    //
+    // @param r - the rectangle
+    ///
+    void markDirty( Rect r );
+
+    ///
+    // Is 'id' a polygon still in the scene?
+    ///
+    bool valid( int id );
+
+public:
+
+    ///
+    // Constructor
+    //
+    // The scene starts out empty, and with its whole canvas dirty.
+    //
+    // @param rast - the Rasterizer to draw with
+    ///
+    Scene( Rasterizer &rast );
+
+    ///
+    // Add a polygon in front of all the others
+    //
+    // @param n    - number of vertices
+    // @param v    - array of vertices
+    // @param c    - the fill color
+    // @param rule - the fill rule
+    // @return the polygon's id
+    ///
+    int add( int n, const Vertex v[], Color c,
+             FillRule rule = FILL_EVEN_ODD );
+
+    ///
+    // Move a polygon
+    //
+    // @param id     - the polygon
+    // @param dx, dy - how far to move it
+    ///
+    void move( int id, float dx, float dy );
+
+    ///
+    // Replace a polygon's vertices
+    //
+    // @param id - the polygon
+    // @param n  - number of vertices
+    // @param v  - array of vertices
+    ///
+    void reshape( int id, int n, const Vertex v[] );
+
+    ///
+    // Change a polygon's color
+    //
+    // @param id - the polygon
+    // @param c  - the new fill color
+    ///
+    void recolor( int id, Color c );
+
+    ///
+    // Remove a polygon (its id is not reused)
+    //
+    // @param id - the polygon
+    ///
+    void remove( int id );
+
+    ///
+    // Redraw everything which has changed since the last update()
+    //
+    // @return the number of rectangles redrawn
+    ///
+    int update( void );
+
+    ///
+    // The rectangles redrawn by the last update()
+    //
+    // They do not overlap, and each lies within the canvas.
+    //
+    // @return the rectangles
+    ///
+    const std::vector<Rect> &dirtyRects( void );
+
+    ///
+    // Draw front to back from now on, or not
+    //
+    // This only applies while the Rasterizer is not anti-aliasing;
+    // the picture is the same either way.  The default is off.
+    //
+    // @param on - true to draw front to back
+    ///
+    void setFrontToBack( bool on );
+
+};
+
+#endif
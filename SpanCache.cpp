@@ -0,0 +1,248 @@
+///
+//  SpanCache.cpp
+//
+//  Cache of rasterized polygons.
+//
+//  Entries live in a list kept in order of use, with a hash table
+//  from key hash to list position; a hash collision is treated as a
+//  miss, and the colliding entry is replaced when the new polygon is
+//  inserted.
+///
+
+#include <cstring>
+
+#include "SpanCache.h"
+
+using namespace std;
+
+///
+// Bookkeeping charged to every entry on top of its arrays
+// (the entry itself, its list node, and its hash table node)
+///
+#define ENTRY_OVERHEAD  (sizeof(Entry) + 64)
+
+///
+// Mix 32 bits into an FNV-1a hash
+///
+static inline uint64_t mix( uint64_t h, uint32_t word )
+{
+    for( int i = 0; i < 4; ++i ) {
+        h ^= (word >> (8 * i)) & 0xff;
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+///
+// Bit pattern of a float
+///
+static inline uint32_t floatBits( float f )
+{
+    uint32_t u;
+    memcpy( &u, &f, 4 );
+    return u;
+}
+
+///
+// Constructor
+//
+// @param budget - memory budget, in bytes
+///
+SpanCache::SpanCache( size_t budget ) :
+    bytes(0), budget(budget), hits(0), misses(0)
+{
+}
+
+///
+// Hash a key
+//
+// @param n    - number of vertices
+// @param v    - array of vertices
+// @param clip - clipping rectangle
+// @param mode - other settings
+// @return the hash
+///
+uint64_t SpanCache::hashKey( int n, const Vertex v[], const int clip[4],
+                             int mode )
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+
+    h = mix( h, (uint32_t) n );
+    h = mix( h, (uint32_t) mode );
+    for( int i = 0; i < 4; ++i ) {
+        h = mix( h, (uint32_t) clip[i] );
+    }
+    for( int i = 0; i < n; ++i ) {
+        h = mix( h, floatBits( v[i].x ) );
+        h = mix( h, floatBits( v[i].y ) );
+    }
+
+    return h;
+}
+
+///
+// Does an entry have this key?
+//
+// Coordinates are compared bit for bit, as that is what the
+// rasterized result depends on.
+///
+bool SpanCache::sameKey( const Entry &e, int n, const Vertex v[],
+                         const int clip[4], int mode )
+{
+    if( e.mode != mode || (int) e.xy.size() != 2 * n ||
+        memcmp( e.clip, clip, sizeof(e.clip) ) != 0 ) {
+        return false;
+    }
+
+    for( int i = 0; i < n; ++i ) {
+        if( floatBits( e.xy[2 * i] ) != floatBits( v[i].x ) ||
+            floatBits( e.xy[2 * i + 1] ) != floatBits( v[i].y ) ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+///
+// Remove one entry
+///
+void SpanCache::evict( list<Entry>::iterator it )
+{
+    bytes -= it->bytes;
+    index.erase( it->hash );
+    entries.erase( it );
+}
+
+///
+// Evict least recently used entries until 'need' more bytes fit
+///
+void SpanCache::makeRoom( size_t need )
+{
+    while( !entries.empty() && bytes + need > budget ) {
+        evict( --entries.end() );
+    }
+}
+
+///
+// Look up a polygon
+//
+// @param n    - number of vertices
+// @param v    - array of vertices
+// @param clip - clipping rectangle (x0, y0, x1, y1)
+// @param mode - other settings which change the result
+// @return the cached spans, or NULL on a miss
+///
+const vector<SpanCache::Span> *SpanCache::find( int n, const Vertex v[],
+                                                const int clip[4], int mode )
+{
+    unordered_map< uint64_t, list<Entry>::iterator >::iterator found =
+        index.find( hashKey( n, v, clip, mode ) );
+
+    if( found == index.end() ||
+        !sameKey( *found->second, n, v, clip, mode ) ) {
+        ++misses;
+        return NULL;
+    }
+
+    // now the most recently used
+    entries.splice( entries.begin(), entries, found->second );
+
+    ++hits;
+    return &entries.front().spans;
+}
+
+///
+// Add a polygon, replacing any entry with the same key
+//
+// @param n     - number of vertices
+// @param v     - array of vertices
+// @param clip  - clipping rectangle (x0, y0, x1, y1)
+// @param mode  - other settings which change the result
+// @param spans - what the polygon rasterized to
+///
+void SpanCache::insert( int n, const Vertex v[], const int clip[4], int mode,
+                        const vector<Span> &spans )
+{
+    uint64_t h = hashKey( n, v, clip, mode );
+
+    unordered_map< uint64_t, list<Entry>::iterator >::iterator found =
+        index.find( h );
+    if( found != index.end() ) {
+        evict( found->second );
+    }
+
+    size_t need = ENTRY_OVERHEAD + 2 * n * sizeof(float) +
+                  spans.size() * sizeof(Span);
+    if( need > budget ) {
+        return;
+    }
+    makeRoom( need );
+
+    entries.push_front( Entry() );
+    Entry &e = entries.front();
+
+    e.hash = h;
+    e.xy.resize( 2 * n );
+    for( int i = 0; i < n; ++i ) {
+        e.xy[2 * i] = v[i].x;
+        e.xy[2 * i + 1] = v[i].y;
+    }
+    memcpy( e.clip, clip, sizeof(e.clip) );
+    e.mode = mode;
+    e.spans = spans;
+    e.bytes = need;
+
+    index[h] = entries.begin();
+    bytes += need;
+}
+
+///
+// Remove every entry (the statistics are kept)
+///
+void SpanCache::clear( void )
+{
+    entries.clear();
+    index.clear();
+    bytes = 0;
+}
+
+///
+// Change the memory budget, evicting entries if need be
+//
+// @param limit - the new budget, in bytes
+///
+void SpanCache::setBudget( size_t limit )
+{
+    budget = limit;
+    makeRoom( 0 );
+}
+
+///
+// Statistics
+///
+
+size_t SpanCache::getBudget( void )
+{
+    return budget;
+}
+
+size_t SpanCache::getBytes( void )
+{
+    return bytes;
+}
+
+size_t SpanCache::getCount( void )
+{
+    return entries.size();
+}
+
+unsigned long SpanCache::getHits( void )
+{
+    return hits;
+}
+
+unsigned long SpanCache::getMisses( void )
+{
+    return misses;
+}
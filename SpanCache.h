@@ -0,0 +1,159 @@
+///
+//  SpanCache.h
+//
+//  Cache of rasterized polygons.
+//
+//  Each entry holds the spans a Rasterizer produced for one polygon,
+//  keyed by the polygon's (x,y) vertex coordinates, the clipping
+//  rectangle, and a 'mode' word standing for any other setting which
+//  changes the result (the fill rule, anti-aliasing).  The spans hold
+//  positions and coverage only, not colors, so a hit can be replayed
+//  in whatever color the polygon is drawn in this time.
+//
+//  The cache is bounded by a memory budget; when a new entry doesn't
+//  fit, the least recently used entries are evicted to make room.
+//
+//  A SpanCache is not thread-safe; give each thread its own.
+///
+
+#ifndef _SPANCACHE_H_
+#define _SPANCACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+
+#include "Types.h"
+
+// default memory budget, in bytes
+#define SPAN_CACHE_BUDGET   (4u << 20)
+
+class SpanCache {
+
+public:
+
+    ///
+    // One cached run of pixels
+    ///
+    struct Span {
+        int y;          // the scanline
+        int x0, x1;     // first pixel, and one past the last pixel
+        int alpha;      // coverage, from 1 to 255
+    };
+
+private:
+
+    ///
+    // One cached polygon
+    ///
+    struct Entry {
+        uint64_t hash;              // hash of the key below
+        std::vector<float> xy;      // vertex coordinates, x and y only
+        int clip[4];                // clipping rectangle
+        int mode;                   // other settings
+        std::vector<Span> spans;    // what the polygon rasterized to
+        size_t bytes;               // memory charged to this entry
+    };
+
+    // entries, most recently used first
+    std::list<Entry> entries;
+
+    // entries by key hash
+    std::unordered_map< uint64_t, std::list<Entry>::iterator > index;
+
+    // memory use, and its limit
+    size_t bytes;
+    size_t budget;
+
+    // lookup statistics
+    unsigned long hits;
+    unsigned long misses;
+
+    ///
+    // Hash a key
+    ///
+    static uint64_t hashKey( int n, const Vertex v[], const int clip[4],
+                             int mode );
+
+    ///
+    // Does an entry have this key?
+    ///
+    static bool sameKey( const Entry &e, int n, const Vertex v[],
+                         const int clip[4], int mode );
+
+    ///
+    // Evict least recently used entries until 'need' more bytes fit
+    ///
+    void makeRoom( size_t need );
+
+    ///
+    // Remove one entry
+    ///
+    void evict( std::list<Entry>::iterator it );
+
+public:
+
+    ///
+    // Constructor
+    //
+    // @param budget - memory budget, in bytes
+    ///
+    SpanCache( size_t budget = SPAN_CACHE_BUDGET );
+
+    ///
+    // Look up a polygon
+    //
+    // A hit makes the entry the most recently used one.
+    //
+    // @param n    - number of vertices
+    // @param v    - array of vertices
+    // @param clip - clipping rectangle (x0, y0, x1, y1)
+    // @param mode - other settings which change the result
+    // @return the cached spans, or NULL on a miss; the pointer is
+    //         good until the next call to insert(), setBudget(),
+    //         or clear()
+    ///
+    const std::vector<Span> *find( int n, const Vertex v[],
+                                   const int clip[4], int mode );
+
+    ///
+    // Add a polygon, replacing any entry with the same key
+    //
+    // Entries too large for the whole budget are not kept.
+    //
+    // @param n     - number of vertices
+    // @param v     - array of vertices
+    // @param clip  - clipping rectangle (x0, y0, x1, y1)
+    // @param mode  - other settings which change the result
+    // @param spans - what the polygon rasterized to
+    ///
+    void insert( int n, const Vertex v[], const int clip[4], int mode,
+                 const std::vector<Span> &spans );
+
+    ///
+    // Remove every entry (the statistics are kept)
+    ///
+    void clear( void );
+
+    ///
+    // Change the memory budget, evicting entries if need be
+    //
+    // @param limit - the new budget, in bytes
+    ///
+    void setBudget( size_t limit );
+
+    ///
+    // Statistics
+    ///
+    size_t getBudget( void );       // memory budget, in bytes
+    size_t getBytes( void );        // memory in use, in bytes
+    size_t getCount( void );        // number of entries
+    unsigned long getHits( void );  // lookups which found an entry
+    unsigned long getMisses( void ); // lookups which didn't
+
+};
+
+#endif
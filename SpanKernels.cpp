@@ -0,0 +1,420 @@
+///
+//  SpanKernels.cpp
+//
+//  Span fill kernels for RGBA8 framebuffers.
+//
+//  There are three implementations of each kernel:  plain C++, SSE2,
+//  and AVX2.  The vector versions are compiled with GCC/Clang target
+//  attributes, so the module itself needs no special compiler flags;
+//  the choice is made once, at the first call, from what the CPU
+//  reports it can do.
+///
+
+#include <cstring>
+
+#include "SpanKernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SPAN_X86 1
+#include <immintrin.h>
+#endif
+
+///
+// Divide a 16-bit product by 255, rounding to nearest
+//
+// Exact for all t <= 255 * 255 + 128.
+///
+static inline uint32_t div255( uint32_t t )
+{
+    t += 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+/////////////////////////////////////
+// Plain C++ versions
+/////////////////////////////////////
+
+static void fillScalar( uint32_t *dst, int n, uint32_t color )
+{
+    for( int i = 0; i < n; ++i ) {
+        dst[i] = color;
+    }
+}
+
+static void blendScalar( uint32_t *dst, int n, uint32_t color )
+{
+    uint8_t src[4];
+    memcpy( src, &color, 4 );
+
+    uint32_t a = src[3];
+    uint32_t na = 255 - a;
+
+    // the alpha channel is blended as if the source alpha were opaque
+    src[3] = 255;
+
+    for( int i = 0; i < n; ++i ) {
+        uint8_t d[4];
+        memcpy( d, &dst[i], 4 );
+        for( int k = 0; k < 4; ++k ) {
+            d[k] = (uint8_t) div255( src[k] * a + d[k] * na );
+        }
+        memcpy( &dst[i], d, 4 );
+    }
+}
+
+static void depthScalar( uint32_t *dst, float *depth, int n,
+                         uint32_t color, float z )
+{
+    for( int i = 0; i < n; ++i ) {
+        if( z <= depth[i] ) {
+            depth[i] = z;
+            dst[i] = color;
+        }
+    }
+}
+
+static void shadeScalar( uint32_t *dst, int n, const float color[4],
+                         const float step[4], int first )
+{
+    // work in 0..255, with the rounding folded into the start
+    float base[4], delta[4];
+    for( int k = 0; k < 4; ++k ) {
+        base[k] = color[k] * 255.0f + 0.5f;
+        delta[k] = step[k] * 255.0f;
+    }
+
+    for( int i = 0; i < n; ++i ) {
+        float fi = (float) (first + i);
+        uint8_t d[4];
+        for( int k = 0; k < 4; ++k ) {
+            // the same operations, in the same order, as the vector
+            // versions; out-of-range values saturate as they do there
+            int v = (int) (base[k] + fi * delta[k]);
+            d[k] = (uint8_t) (v < 0 ? 0 : v > 255 ? 255 : v);
+        }
+        memcpy( &dst[i], d, 4 );
+    }
+}
+
+static void shadeScalar( uint32_t *dst, int n, const float color[4],
+                         const float step[4] )
+{
+    shadeScalar( dst, n, color, step, 0 );
+}
+
+#ifdef SPAN_X86
+
+/////////////////////////////////////
+// SSE2 versions (4 pixels per step)
+/////////////////////////////////////
+
+__attribute__((target("sse2")))
+static void fillSSE2( uint32_t *dst, int n, uint32_t color )
+{
+    __m128i c = _mm_set1_epi32( (int) color );
+    int i = 0;
+
+    for( ; i + 4 <= n; i += 4 ) {
+        _mm_storeu_si128( (__m128i *) (dst + i), c );
+    }
+    fillScalar( dst + i, n - i, color );
+}
+
+__attribute__((target("sse2")))
+static void blendSSE2( uint32_t *dst, int n, uint32_t color )
+{
+    uint8_t src[4];
+    memcpy( src, &color, 4 );
+    uint16_t a = src[3];
+    src[3] = 255;
+    uint32_t opaque;
+    memcpy( &opaque, src, 4 );
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i s = _mm_unpacklo_epi8( _mm_set1_epi32( (int) opaque ), zero );
+    __m128i sa = _mm_mullo_epi16( s, _mm_set1_epi16( a ) );
+    __m128i na = _mm_set1_epi16( 255 - a );
+    __m128i half = _mm_set1_epi16( 128 );
+    int i = 0;
+
+    for( ; i + 4 <= n; i += 4 ) {
+        __m128i d = _mm_loadu_si128( (__m128i *) (dst + i) );
+        __m128i lo = _mm_unpacklo_epi8( d, zero );
+        __m128i hi = _mm_unpackhi_epi8( d, zero );
+
+        lo = _mm_add_epi16( _mm_add_epi16( sa, _mm_mullo_epi16( lo, na ) ),
+                            half );
+        hi = _mm_add_epi16( _mm_add_epi16( sa, _mm_mullo_epi16( hi, na ) ),
+                            half );
+        lo = _mm_srli_epi16( _mm_add_epi16( lo, _mm_srli_epi16( lo, 8 ) ), 8 );
+        hi = _mm_srli_epi16( _mm_add_epi16( hi, _mm_srli_epi16( hi, 8 ) ), 8 );
+
+        _mm_storeu_si128( (__m128i *) (dst + i), _mm_packus_epi16( lo, hi ) );
+    }
+    blendScalar( dst + i, n - i, color );
+}
+
+__attribute__((target("sse2")))
+static void depthSSE2( uint32_t *dst, float *depth, int n,
+                       uint32_t color, float z )
+{
+    __m128i c = _mm_set1_epi32( (int) color );
+    __m128 zz = _mm_set1_ps( z );
+    int i = 0;
+
+    for( ; i + 4 <= n; i += 4 ) {
+        __m128 zb = _mm_loadu_ps( depth + i );
+        __m128 pass = _mm_cmple_ps( zz, zb );
+        __m128i m = _mm_castps_si128( pass );
+        __m128i d = _mm_loadu_si128( (__m128i *) (dst + i) );
+
+        d = _mm_or_si128( _mm_and_si128( m, c ), _mm_andnot_si128( m, d ) );
+        zb = _mm_or_ps( _mm_and_ps( pass, zz ), _mm_andnot_ps( pass, zb ) );
+
+        _mm_storeu_si128( (__m128i *) (dst + i), d );
+        _mm_storeu_ps( depth + i, zb );
+    }
+    depthScalar( dst + i, depth + i, n - i, color, z );
+}
+
+__attribute__((target("sse2")))
+static void shadeSSE2( uint32_t *dst, int n, const float color[4],
+                       const float step[4] )
+{
+    // one pixel's four channels per register, in 0..255, with
+    // the rounding folded into the start
+    __m128 scale = _mm_set1_ps( 255.0f );
+    __m128 c = _mm_add_ps( _mm_mul_ps( _mm_loadu_ps( color ), scale ),
+                           _mm_set1_ps( 0.5f ) );
+    __m128 s = _mm_mul_ps( _mm_loadu_ps( step ), scale );
+    __m128 four = _mm_set1_ps( 4.0f );
+    __m128 fi = _mm_setzero_ps();
+    int i = 0;
+
+    for( ; i + 4 <= n; i += 4 ) {
+        // the four pixel indices are independent of each other, so
+        // the pixels don't wait on one another
+        __m128i p[4];
+        for( int k = 0; k < 4; ++k ) {
+            __m128 fk = _mm_add_ps( fi, _mm_set1_ps( (float) k ) );
+            p[k] = _mm_cvttps_epi32( _mm_add_ps( c, _mm_mul_ps( fk, s ) ) );
+        }
+        fi = _mm_add_ps( fi, four );
+
+        // saturating packs clamp to 0..255, like the scalar version
+        __m128i lo = _mm_packs_epi32( p[0], p[1] );
+        __m128i hi = _mm_packs_epi32( p[2], p[3] );
+        _mm_storeu_si128( (__m128i *) (dst + i), _mm_packus_epi16( lo, hi ) );
+    }
+    shadeScalar( dst + i, n - i, color, step, i );
+}
+
+/////////////////////////////////////
+// AVX2 versions (8 pixels per step)
+/////////////////////////////////////
+
+__attribute__((target("avx2")))
+static void fillAVX2( uint32_t *dst, int n, uint32_t color )
+{
+    __m256i c = _mm256_set1_epi32( (int) color );
+    int i = 0;
+
+    for( ; i + 8 <= n; i += 8 ) {
+        _mm256_storeu_si256( (__m256i *) (dst + i), c );
+    }
+    fillScalar( dst + i, n - i, color );
+}
+
+__attribute__((target("avx2")))
+static void blendAVX2( uint32_t *dst, int n, uint32_t color )
+{
+    // short runs (e.g., anti-aliased edge pixels) would spend more
+    // time getting the 256-bit unit going than blending
+    if( n < 8 ) {
+        blendSSE2( dst, n, color );
+        return;
+    }
+
+    uint8_t src[4];
+    memcpy( src, &color, 4 );
+    uint16_t a = src[3];
+    src[3] = 255;
+    uint32_t opaque;
+    memcpy( &opaque, src, 4 );
+
+    __m256i zero = _mm256_setzero_si256();
+    __m256i s = _mm256_unpacklo_epi8( _mm256_set1_epi32( (int) opaque ),
+                                      zero );
+    __m256i sa = _mm256_mullo_epi16( s, _mm256_set1_epi16( a ) );
+    __m256i na = _mm256_set1_epi16( 255 - a );
+    __m256i half = _mm256_set1_epi16( 128 );
+    int i = 0;
+
+    // unpack/pack work within 128-bit lanes, so pixel order is kept
+    for( ; i + 8 <= n; i += 8 ) {
+        __m256i d = _mm256_loadu_si256( (__m256i *) (dst + i) );
+        __m256i lo = _mm256_unpacklo_epi8( d, zero );
+        __m256i hi = _mm256_unpackhi_epi8( d, zero );
+
+        lo = _mm256_add_epi16(
+                 _mm256_add_epi16( sa, _mm256_mullo_epi16( lo, na ) ), half );
+        hi = _mm256_add_epi16(
+                 _mm256_add_epi16( sa, _mm256_mullo_epi16( hi, na ) ), half );
+        lo = _mm256_srli_epi16(
+                 _mm256_add_epi16( lo, _mm256_srli_epi16( lo, 8 ) ), 8 );
+        hi = _mm256_srli_epi16(
+                 _mm256_add_epi16( hi, _mm256_srli_epi16( hi, 8 ) ), 8 );
+
+        _mm256_storeu_si256( (__m256i *) (dst + i),
+                             _mm256_packus_epi16( lo, hi ) );
+    }
+    blendScalar( dst + i, n - i, color );
+}
+
+__attribute__((target("avx2")))
+static void depthAVX2( uint32_t *dst, float *depth, int n,
+                       uint32_t color, float z )
+{
+    __m256i c = _mm256_set1_epi32( (int) color );
+    __m256 zz = _mm256_set1_ps( z );
+    int i = 0;
+
+    for( ; i + 8 <= n; i += 8 ) {
+        __m256 zb = _mm256_loadu_ps( depth + i );
+        __m256 pass = _mm256_cmp_ps( zz, zb, _CMP_LE_OQ );
+        __m256i d = _mm256_loadu_si256( (__m256i *) (dst + i) );
+
+        d = _mm256_blendv_epi8( d, c, _mm256_castps_si256( pass ) );
+        zb = _mm256_blendv_ps( zb, zz, pass );
+
+        _mm256_storeu_si256( (__m256i *) (dst + i), d );
+        _mm256_storeu_ps( depth + i, zb );
+    }
+    depthScalar( dst + i, depth + i, n - i, color, z );
+}
+
+#endif
+
+/////////////////////////////////////
+// Dispatch
+/////////////////////////////////////
+
+///
+// The implementation chosen for this CPU
+///
+static struct {
+    void (*fill)( uint32_t *, int, uint32_t );
+    void (*blend)( uint32_t *, int, uint32_t );
+    void (*depth)( uint32_t *, float *, int, uint32_t, float );
+    void (*shade)( uint32_t *, int, const float *, const float * );
+    const char *name;
+} kernels;
+
+///
+// Pick the widest implementation the CPU supports
+///
+static void chooseKernels( void )
+{
+    kernels.fill = fillScalar;
+    kernels.blend = blendScalar;
+    kernels.depth = depthScalar;
+    kernels.shade = shadeScalar;
+    kernels.name = "scalar";
+
+#ifdef SPAN_X86
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports( "avx2" ) ) {
+        kernels.fill = fillAVX2;
+        kernels.blend = blendAVX2;
+        kernels.depth = depthAVX2;
+        // with one pixel per 128-bit register, 256-bit registers
+        // would only add lane shuffling to the packing
+        kernels.shade = shadeSSE2;
+        kernels.name = "avx2";
+    } else if( __builtin_cpu_supports( "sse2" ) ) {
+        kernels.fill = fillSSE2;
+        kernels.blend = blendSSE2;
+        kernels.depth = depthSSE2;
+        kernels.shade = shadeSSE2;
+        kernels.name = "sse2";
+    }
+#endif
+}
+
+///
+// Make sure the kernels have been chosen
+//
+// A function-local static is initialized exactly once, even
+// if several threads get here at the same time.
+///
+static inline void checkKernels( void )
+{
+    static bool chosen = ( chooseKernels(), true );
+    (void) chosen;
+}
+
+///
+// Fill a span with a solid color
+//
+// @param dst    first pixel of the span
+// @param n      number of pixels
+// @param color  packed RGBA8 color
+///
+void spanFill( uint32_t *dst, int n, uint32_t color )
+{
+    checkKernels();
+    kernels.fill( dst, n, color );
+}
+
+///
+// Blend a color over a span ("source over")
+//
+// @param dst    first pixel of the span
+// @param n      number of pixels
+// @param color  packed RGBA8 color, including its alpha
+///
+void spanBlend( uint32_t *dst, int n, uint32_t color )
+{
+    checkKernels();
+    kernels.blend( dst, n, color );
+}
+
+///
+// Fill a span with a solid color, subject to a depth test
+//
+// @param dst    first pixel of the span
+// @param depth  depth value for the first pixel of the span
+// @param n      number of pixels
+// @param color  packed RGBA8 color
+// @param z      depth of the span
+///
+void spanFillDepth( uint32_t *dst, float *depth, int n,
+                    uint32_t color, float z )
+{
+    checkKernels();
+    kernels.depth( dst, depth, n, color, z );
+}
+
+///
+// Fill a span with a linearly changing color
+//
+// @param dst    first pixel of the span
+// @param n      number of pixels
+// @param color  R, G, B, A of the first pixel
+// @param step   change in R, G, B, A from one pixel to the next
+///
+void spanShade( uint32_t *dst, int n, const float color[4],
+                const float step[4] )
+{
+    checkKernels();
+    kernels.shade( dst, n, color, step );
+}
+
+///
+// Name of the implementation in use ("avx2", "sse2", or "scalar")
+///
+const char *spanKernelName( void )
+{
+    checkKernels();
+    return kernels.name;
+}
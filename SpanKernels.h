@@ -0,0 +1,81 @@
+///
+//  SpanKernels.h
+//
+//  Span fill kernels for RGBA8 framebuffers.
+//
+//  Each kernel fills a run of n pixels starting at 'dst'.  Pixels are
+//  32-bit words holding R, G, B, A bytes in memory order, as stored by
+//  a dense Canvas (see Canvas::useFramebuffer()).  Colors are passed
+//  in the same layout.
+//
+//  The first call picks the widest implementation the CPU supports
+//  (AVX2, then SSE2, then plain C++).  All implementations produce
+//  bit-identical results.
+//
+//  This code can be compiled only as C++.
+///
+
+#ifndef _SPANKERNELS_H_
+#define _SPANKERNELS_H_
+
+#include <stdint.h>
+
+///
+// Fill a span with a solid color
+//
+// @param dst    first pixel of the span
+// @param n      number of pixels
+// @param color  packed RGBA8 color
+///
+void spanFill( uint32_t *dst, int n, uint32_t color );
+
+///
+// Blend a color over a span ("source over")
+//
+// Each color channel becomes (src * a + dst * (255 - a)) / 255,
+// rounded, where 'a' is the alpha byte of 'color'; the alpha
+// channel becomes a + dst_alpha * (255 - a) / 255.
+//
+// @param dst    first pixel of the span
+// @param n      number of pixels
+// @param color  packed RGBA8 color, including its alpha
+///
+void spanBlend( uint32_t *dst, int n, uint32_t color );
+
+///
+// Fill a span with a solid color, subject to a depth test
+//
+// A pixel is written (and its depth replaced by 'z') only if
+// z <= depth[i], the same test as GL_LEQUAL.
+//
+// @param dst    first pixel of the span
+// @param depth  depth value for the first pixel of the span
+// @param n      number of pixels
+// @param color  packed RGBA8 color
+// @param z      depth of the span
+///
+void spanFillDepth( uint32_t *dst, float *depth, int n,
+                    uint32_t color, float z );
+
+///
+// Fill a span with a linearly changing color
+//
+// Pixel i gets channel k = color[k] + i * step[k], scaled to 0..255,
+// rounded to nearest, and clamped.  Each pixel's color is computed
+// from its index, not accumulated, so there is no drift along the
+// span.
+//
+// @param dst    first pixel of the span
+// @param n      number of pixels
+// @param color  R, G, B, A of the first pixel
+// @param step   change in R, G, B, A from one pixel to the next
+///
+void spanShade( uint32_t *dst, int n, const float color[4],
+                const float step[4] );
+
+///
+// Name of the implementation in use ("avx2", "sse2", or "scalar")
+///
+const char *spanKernelName( void );
+
+#endif
@@ -0,0 +1,197 @@
+///
+//  Texture.cpp
+//
+//  In-memory RGBA8 texture, sampled a run of pixels at a time.
+//
+//  A run is followed in 16.16 fixed point texel coordinates.  The
+//  bilinear filter blends texels two channels at a time in 32-bit
+//  integers, with 8-bit weights.
+///
+
+#include <cmath>
+#include <cstring>
+
+#include "Texture.h"
+
+using namespace std;
+
+///
+// Fixed point texel coordinates
+///
+
+#define TEX_FRAC_BITS   16
+
+///
+// Wrap a texel index into [0,n)
+///
+static inline int wrapTexel( int i, int n )
+{
+    if( (unsigned) i < (unsigned) n ) {
+        return i;
+    }
+    i %= n;
+    return i < 0 ? i + n : i;
+}
+
+///
+// Start of a run along one axis, in fixed point texels
+//
+// @param t   - texture coordinate
+// @param n   - texels along the axis
+// @param off - offset of the sample from the texel corner
+///
+static inline long long fixedStart( float t, int n, float off )
+{
+    float s = t * n - off;
+
+    // keep the coordinate (and everything stepped from it over one
+    // run) well within range; the texture repeats anyway
+    s -= floorf( s / n ) * n;
+
+    return (long long) ( s * (float) (1 << TEX_FRAC_BITS) );
+}
+
+///
+// Blend two texels, two channels at a time
+//
+// @param p, q - the texels
+// @param f    - weight of q, from 0 to 255
+///
+static inline uint32_t blend( uint32_t p, uint32_t q, uint32_t f )
+{
+    uint32_t g = 256 - f;
+    uint32_t rb = ((p & 0xff00ff) * g + (q & 0xff00ff) * f) >> 8;
+    uint32_t ga = ((p >> 8) & 0xff00ff) * g + ((q >> 8) & 0xff00ff) * f;
+    return (rb & 0xff00ff) | (ga & 0xff00ff00);
+}
+
+///
+// Constructor
+//
+// @param w    - width, in texels (at least 1)
+// @param h    - height, in texels (at least 1)
+// @param data - w * h RGBA8 texels to copy, or NULL for black
+///
+Texture::Texture( int w, int h, const uint32_t *data ) :
+    width(w > 0 ? w : 1), height(h > 0 ? h : 1), filter(TEX_NEAREST)
+{
+    if( data && w > 0 && h > 0 ) {
+        texels.assign( data, data + width * height );
+    } else {
+        // opaque black
+        uint8_t black[4] = { 0, 0, 0, 255 };
+        uint32_t t;
+        memcpy( &t, black, 4 );
+        texels.assign( width * height, t );
+    }
+}
+
+///
+// Texture dimensions
+///
+
+int Texture::getWidth( void )
+{
+    return width;
+}
+
+int Texture::getHeight( void )
+{
+    return height;
+}
+
+///
+// Set one texel
+//
+// @param x, y - the texel
+// @param c    - its color (components from 0 to 1)
+///
+void Texture::setTexel( int x, int y, Color c )
+{
+    if( x < 0 || x >= width || y < 0 || y >= height ) {
+        return;
+    }
+
+    float rgba[4] = { c.r, c.g, c.b, c.a };
+    uint8_t bytes[4];
+    for( int k = 0; k < 4; ++k ) {
+        float f = fminf( fmaxf( rgba[k], 0.0f ), 1.0f );
+        bytes[k] = (uint8_t) (f * 255.0f + 0.5f);
+    }
+
+    memcpy( &texels[ y * width + x ], bytes, 4 );
+}
+
+///
+// Choose the filter for sampling from now on
+//
+// @param f - TEX_NEAREST or TEX_BILINEAR
+///
+void Texture::setFilter( TexFilter f )
+{
+    filter = f;
+}
+
+///
+// The filter in use
+//
+// @return the filter
+///
+TexFilter Texture::getFilter( void )
+{
+    return filter;
+}
+
+///
+// Sample a run of pixels along a line through the texture
+//
+// @param dst    - where the n RGBA8 samples go
+// @param n      - number of pixels
+// @param u, v   - texture coordinates of pixel 0
+// @param du, dv - their change from one pixel to the next
+///
+void Texture::sampleSpan( uint32_t *dst, int n, float u, float v,
+                          float du, float dv )
+{
+    const float one = (float) (1 << TEX_FRAC_BITS);
+
+    // bilinear weights are measured from texel centers
+    float off = filter == TEX_BILINEAR ? 0.5f : 0.0f;
+
+    long long fx = fixedStart( u, width, off );
+    long long fy = fixedStart( v, height, off );
+    long long dx = (long long) ( du * width * one );
+    long long dy = (long long) ( dv * height * one );
+
+    const uint32_t *tex = &texels[0];
+
+    if( filter == TEX_NEAREST ) {
+        for( int i = 0; i < n; ++i ) {
+            int x = wrapTexel( (int) (fx >> TEX_FRAC_BITS), width );
+            int y = wrapTexel( (int) (fy >> TEX_FRAC_BITS), height );
+            dst[i] = tex[ y * width + x ];
+            fx += dx;
+            fy += dy;
+        }
+        return;
+    }
+
+    for( int i = 0; i < n; ++i ) {
+        int x0 = wrapTexel( (int) (fx >> TEX_FRAC_BITS), width );
+        int y0 = wrapTexel( (int) (fy >> TEX_FRAC_BITS), height );
+        int x1 = x0 + 1 < width ? x0 + 1 : 0;
+        int y1 = y0 + 1 < height ? y0 + 1 : 0;
+
+        // top 8 bits of the fractions
+        uint32_t ax = (uint32_t) (fx >> (TEX_FRAC_BITS - 8)) & 0xff;
+        uint32_t ay = (uint32_t) (fy >> (TEX_FRAC_BITS - 8)) & 0xff;
+
+        const uint32_t *r0 = tex + y0 * width;
+        const uint32_t *r1 = tex + y1 * width;
+        dst[i] = blend( blend( r0[x0], r0[x1], ax ),
+                        blend( r1[x0], r1[x1], ax ), ay );
+
+        fx += dx;
+        fy += dy;
+    }
+}
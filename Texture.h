@@ -0,0 +1,108 @@
+///
+//  Texture.h
+//
+//  In-memory RGBA8 texture, sampled a run of pixels at a time.
+//
+//  Texture coordinates follow the GL conventions:  (u,v) = (0,0) is
+//  the first texel of the first row, (1,1) the far corner of the
+//  last, texel centers lie half a texel in from their edges, and
+//  coordinates outside [0,1] repeat the texture.
+//
+//  Runs are sampled along a straight line through texture space
+//  (see sampleSpan()); the Rasterizer keeps that line close to the
+//  true perspective mapping by restarting it every few pixels.
+///
+
+#ifndef _TEXTURE_H_
+#define _TEXTURE_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "Types.h"
+
+///
+// Texture filters
+///
+
+typedef enum sTexFilter {
+    TEX_NEAREST,        // the texel the sample falls in
+    TEX_BILINEAR        // the four nearest texels, weighted by distance
+} TexFilter;
+
+class Texture {
+
+    // dimensions, in texels
+    int width;
+    int height;
+
+    // texels, row-major from the v = 0 row, each four bytes R, G,
+    // B, A (the same layout as Canvas::getPixels())
+    std::vector<uint32_t> texels;
+
+    // filter used by sampleSpan()
+    TexFilter filter;
+
+public:
+
+    ///
+    // Constructor
+    //
+    // @param w    - width, in texels (at least 1)
+    // @param h    - height, in texels (at least 1)
+    // @param data - w * h RGBA8 texels to copy, or NULL for black
+    ///
+    Texture( int w, int h, const uint32_t *data = 0 );
+
+    ///
+    // Texture dimensions
+    //
+    // @return the width (or height), in texels
+    ///
+    int getWidth( void );
+    int getHeight( void );
+
+    ///
+    // Set one texel
+    //
+    // Coordinates outside the texture are ignored.
+    //
+    // @param x, y - the texel
+    // @param c    - its color (components from 0 to 1)
+    ///
+    void setTexel( int x, int y, Color c );
+
+    ///
+    // Choose the filter for sampling from now on
+    //
+    // The default is TEX_NEAREST.
+    //
+    // @param f - TEX_NEAREST or TEX_BILINEAR
+    ///
+    void setFilter( TexFilter f );
+
+    ///
+    // The filter in use
+    //
+    // @return the filter
+    ///
+    TexFilter getFilter( void );
+
+    ///
+    // Sample a run of pixels along a line through the texture
+    //
+    // Pixel i is sampled at (u + i * du, v + i * dv).  The line is
+    // followed in fixed point, with no division per pixel.
+    //
+    // @param dst    - where the n RGBA8 samples go
+    // @param n      - number of pixels
+    // @param u, v   - texture coordinates of pixel 0
+    // @param du, dv - their change from one pixel to the next
+    ///
+    void sampleSpan( uint32_t *dst, int n, float u, float v,
+                     float du, float dv );
+
+};
+
+#endif
@@ -0,0 +1,322 @@
+///
+//  TileRasterizer.cpp
+//
+//  Scene-level rasterizer which bins polygons into screen tiles and
+//  fills the tiles in parallel.
+//
+//  Polygons are submitted in painter's-algorithm order.  Each tile
+//  keeps the polygons touching it in submission order, and each tile
+//  is filled by exactly one thread, so the result is identical to
+//  drawing the same polygons one after another with a Rasterizer.
+///
+
+#include <cmath>
+#include <algorithm>
+
+#include "TileRasterizer.h"
+
+using namespace std;
+
+///
+// Constructor
+//
+// @param canvas   The Canvas to use
+// @param nthreads Number of threads (0 = one per hardware thread)
+// @param tile     Tile width and height, in pixels
+///
+TileRasterizer::TileRasterizer( Canvas &canvas, int nthreads, int tile ) :
+    tileSize(tile > 0 ? tile : 64), generation(0), running(0),
+    quit(false), C(canvas)
+{
+    if( nthreads < 1 ) {
+        nthreads = (int) thread::hardware_concurrency();
+        if( nthreads < 1 ) {
+            nthreads = 1;
+        }
+    }
+
+    tilesX = (C.getWidth() + tileSize - 1) / tileSize;
+    tilesY = (C.getHeight() + tileSize - 1) / tileSize;
+    bins.resize( tilesX * tilesY );
+
+    for( int i = 0; i < nthreads; ++i ) {
+        Worker *w = new Worker;
+        w->R = new Rasterizer( C.getHeight(), C );
+        workers.push_back( w );
+    }
+
+    // the caller of render() acts as worker 0
+    for( int i = 1; i < nthreads; ++i ) {
+        threads.push_back( thread( &TileRasterizer::threadMain, this, i ) );
+    }
+}
+
+///
+// Destructor
+///
+TileRasterizer::~TileRasterizer( void )
+{
+    {
+        lock_guard<mutex> guard( poolLock );
+        quit = true;
+    }
+    wake.notify_all();
+
+    for( size_t i = 0; i < threads.size(); ++i ) {
+        threads[i].join();
+    }
+
+    for( size_t i = 0; i < workers.size(); ++i ) {
+        delete workers[i]->R;
+        delete workers[i];
+    }
+}
+
+///
+// Submit a filled polygon for the next render()
+//
+// @param n    - number of vertices
+// @param v    - array of vertices
+// @param c    - the fill color
+// @param rule - the fill rule
+///
+void TileRasterizer::addPolygon( int n, const Vertex v[], Color c,
+                                 FillRule rule )
+{
+    if( n < 3 ) {
+        return;
+    }
+
+    Polygon p = { (int) verts.size(), n, c, rule };
+
+    verts.insert( verts.end(), v, v + n );
+    polys.push_back( p );
+}
+
+///
+// Forget every submitted polygon without drawing it
+///
+void TileRasterizer::clear( void )
+{
+    verts.clear();
+    polys.clear();
+}
+
+///
+// Number of threads used by render()
+//
+// @return the thread count
+///
+int TileRasterizer::numThreads( void )
+{
+    return workers.size();
+}
+
+///
+// Put every polygon into the bins of the tiles its
+// bounding box touches
+///
+void TileRasterizer::binPolygons( void )
+{
+    float w = (float) C.getWidth(), h = (float) C.getHeight();
+
+    for( size_t i = 0; i < polys.size(); ++i ) {
+        const Polygon &p = polys[i];
+        const Vertex *v = &verts[p.first];
+
+        float xmin = v[0].x, xmax = v[0].x;
+        float ymin = v[0].y, ymax = v[0].y;
+        for( int k = 1; k < p.count; ++k ) {
+            xmin = min( xmin, v[k].x );
+            xmax = max( xmax, v[k].x );
+            ymin = min( ymin, v[k].y );
+            ymax = max( ymax, v[k].y );
+        }
+
+        // NaN coordinates give no usable bounds
+        if( !(xmin <= xmax && ymin <= ymax) ) {
+            continue;
+        }
+
+        // keep far off-canvas coordinates in range of an int
+        xmin = min( max( xmin, -1.0f ), w + 1.0f );
+        xmax = min( max( xmax, -1.0f ), w + 1.0f );
+        ymin = min( max( ymin, -1.0f ), h + 1.0f );
+        ymax = min( max( ymax, -1.0f ), h + 1.0f );
+
+        // pixels filled lie in [ceil(min),ceil(max)) in each direction
+        int tx0 = max( (int) ceilf( xmin ) / tileSize, 0 );
+        int tx1 = min( ((int) ceilf( xmax ) - 1) / tileSize, tilesX - 1 );
+        int ty0 = max( (int) ceilf( ymin ) / tileSize, 0 );
+        int ty1 = min( ((int) ceilf( ymax ) - 1) / tileSize, tilesY - 1 );
+
+        // completely off the canvas, or too thin to fill anything
+        if( xmax <= 0.0f || ymax <= 0.0f || tx0 > tx1 || ty0 > ty1 ) {
+            continue;
+        }
+
+        for( int ty = ty0; ty <= ty1; ++ty ) {
+            for( int tx = tx0; tx <= tx1; ++tx ) {
+                bins[ty * tilesX + tx].push_back( i );
+            }
+        }
+    }
+}
+
+///
+// Fill one tile
+//
+// @param w    - the worker doing the filling
+// @param tile - which tile
+///
+void TileRasterizer::fillTile( Worker &w, int tile )
+{
+    int x0 = (tile % tilesX) * tileSize;
+    int y0 = (tile / tilesX) * tileSize;
+
+    w.R->setClip( x0, y0, x0 + tileSize, y0 + tileSize );
+
+    const vector<int> &bin = bins[tile];
+    for( size_t i = 0; i < bin.size(); ++i ) {
+        const Polygon &p = polys[bin[i]];
+        w.R->setFillRule( p.rule );
+        w.R->drawPolygon( p.count, &verts[p.first], p.color );
+    }
+}
+
+///
+// Fill tiles until none are left anywhere
+//
+// Each worker takes tiles from the front of its own queue; once that
+// is empty, it steals from the back of the other queues.  Queues only
+// shrink during a render, so finding them all empty means we're done.
+//
+// @param id - the worker doing the filling
+///
+void TileRasterizer::work( int id )
+{
+    Worker &self = *workers[id];
+    int n = workers.size();
+
+    for( ;; ) {
+        int tile = -1;
+
+        {
+            lock_guard<mutex> guard( self.lock );
+            if( !self.tiles.empty() ) {
+                tile = self.tiles.front();
+                self.tiles.pop_front();
+            }
+        }
+
+        for( int k = 1; tile < 0 && k < n; ++k ) {
+            Worker &victim = *workers[(id + k) % n];
+            lock_guard<mutex> guard( victim.lock );
+            if( !victim.tiles.empty() ) {
+                tile = victim.tiles.back();
+                victim.tiles.pop_back();
+            }
+        }
+
+        if( tile < 0 ) {
+            return;
+        }
+
+        fillTile( self, tile );
+    }
+}
+
+///
+// Main loop of a pool thread
+//
+// @param id - the worker this thread runs
+///
+void TileRasterizer::threadMain( int id )
+{
+    unsigned long seen = 0;
+
+    for( ;; ) {
+        {
+            unique_lock<mutex> guard( poolLock );
+            while( !quit && generation == seen ) {
+                wake.wait( guard );
+            }
+            if( quit ) {
+                return;
+            }
+            seen = generation;
+        }
+
+        work( id );
+
+        {
+            lock_guard<mutex> guard( poolLock );
+            if( --running == 0 ) {
+                done.notify_one();
+            }
+        }
+    }
+}
+
+///
+// Draw every submitted polygon into the canvas, then forget them
+///
+void TileRasterizer::render( void )
+{
+    if( polys.empty() ) {
+        return;
+    }
+
+    // without a framebuffer, the canvas can't take parallel writes
+    if( !C.hasFramebuffer() ) {
+        Rasterizer &R = *workers[0]->R;
+        R.resetClip();
+        for( size_t i = 0; i < polys.size(); ++i ) {
+            R.setFillRule( polys[i].rule );
+            R.drawPolygon( polys[i].count, &verts[polys[i].first],
+                           polys[i].color );
+        }
+        clear();
+        return;
+    }
+
+    binPolygons();
+
+    // deal the occupied tiles out in contiguous runs, so each
+    // worker starts with a compact region of the canvas
+    occupied.clear();
+    for( size_t t = 0; t < bins.size(); ++t ) {
+        if( !bins[t].empty() ) {
+            occupied.push_back( t );
+        }
+    }
+
+    int n = workers.size();
+    for( int i = 0; i < n; ++i ) {
+        size_t from = occupied.size() * i / n;
+        size_t to = occupied.size() * (i + 1) / n;
+        workers[i]->tiles.assign( occupied.begin() + from,
+                                  occupied.begin() + to );
+    }
+
+    {
+        lock_guard<mutex> guard( poolLock );
+        running = n - 1;
+        ++generation;
+    }
+    wake.notify_all();
+
+    work( 0 );
+
+    {
+        unique_lock<mutex> guard( poolLock );
+        while( running > 0 ) {
+            done.wait( guard );
+        }
+    }
+
+    for( size_t t = 0; t < occupied.size(); ++t ) {
+        bins[occupied[t]].clear();
+    }
+    clear();
+}
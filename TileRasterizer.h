@@ -0,0 +1,159 @@
+///
+//  TileRasterizer.h
+//
+//  Scene-level rasterizer which bins polygons into screen tiles and
+//  fills the tiles in parallel.
+//
+//  Polygons are submitted in painter's-algorithm order.  Each tile
+//  keeps the polygons touching it in submission order, and each tile
+//  is filled by exactly one thread, so the result is identical to
+//  drawing the same polygons one after another with a Rasterizer.
+//
+//  Tiles are handed out through per-thread work queues; a thread
+//  which runs out of tiles steals from the back of another thread's
+//  queue.  Parallel filling needs a Canvas with a dense framebuffer
+//  (see Canvas::useFramebuffer()); with any other Canvas, render()
+//  falls back to drawing the polygons serially.
+///
+
+#ifndef _TILERASTERIZER_H_
+#define _TILERASTERIZER_H_
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "Types.h"
+#include "Canvas.h"
+#include "Rasterizer.h"
+
+class TileRasterizer {
+
+    ///
+    // A submitted polygon
+    ///
+    struct Polygon {
+        int first;          // index of its first vertex in 'verts'
+        int count;          // number of vertices
+        Color color;        // fill color
+        FillRule rule;      // fill rule
+    };
+
+    ///
+    // Per-thread state
+    ///
+    struct Worker {
+        Rasterizer *R;              // private scanline engine
+        std::deque<int> tiles;      // tiles still to be filled
+        std::mutex lock;            // guards 'tiles'
+    };
+
+    // submitted geometry
+    std::vector<Vertex> verts;
+    std::vector<Polygon> polys;
+
+    // tile grid
+    int tileSize;
+    int tilesX, tilesY;
+
+    // polygons touching each tile, in submission order
+    std::vector< std::vector<int> > bins;
+
+    // the tiles with polygons in them, to be dealt out to the workers
+    std::vector<int> occupied;
+
+    // the thread pool; thread 0 is the caller of render()
+    std::vector<Worker *> workers;
+    std::vector<std::thread> threads;
+
+    // pool synchronization
+    std::mutex poolLock;
+    std::condition_variable wake;
+    std::condition_variable done;
+    unsigned long generation;   // bumped for each render()
+    int running;                // threads still working on this render
+    bool quit;
+
+    ///
+    // Put every polygon into the bins of the tiles its
+    // bounding box touches
+    ///
+    void binPolygons( void );
+
+    ///
+    // Fill tiles until none are left anywhere
+    //
+    // @param id - the worker doing the filling
+    ///
+    void work( int id );
+
+    ///
+    // Fill one tile
+    //
+    // @param w    - the worker doing the filling
+    // @param tile - which tile
+    ///
+    void fillTile( Worker &w, int tile );
+
+    ///
+    // Main loop of a pool thread
+    //
+    // @param id - the worker this thread runs
+    ///
+    void threadMain( int id );
+
+public:
+
+    ///
+    // Drawing canvas
+    ///
+
+    Canvas &C;
+
+    ///
+    // Constructor
+    //
+    // @param canvas   The Canvas to use
+    // @param nthreads Number of threads (0 = one per hardware thread)
+    // @param tile     Tile width and height, in pixels
+    ///
+    TileRasterizer( Canvas &canvas, int nthreads = 0, int tile = 64 );
+
+    ///
+    // Destructor
+    ///
+    ~TileRasterizer( void );
+
+    ///
+    // Submit a filled polygon for the next render()
+    //
+    // @param n    - number of vertices
+    // @param v    - array of vertices
+    // @param c    - the fill color
+    // @param rule - the fill rule
+    ///
+    void addPolygon( int n, const Vertex v[], Color c,
+                     FillRule rule = FILL_EVEN_ODD );
+
+    ///
+    // Draw every submitted polygon into the canvas, then forget them
+    ///
+    void render( void );
+
+    ///
+    // Forget every submitted polygon without drawing it
+    ///
+    void clear( void );
+
+    ///
+    // Number of threads used by render()
+    //
+    // @return the thread count
+    ///
+    int numThreads( void );
+
+};
+
+#endif
@@ -54,4 +54,13 @@ typedef struct st_vertex {
     float w;
 } Vertex;
 
+///
+// A rectangle of pixels, x0 <= x < x1 and y0 <= y < y1
+///
+
+typedef struct st_rect {
+    int x0, y0;
+    int x1, y1;
+} Rect;
+
 #endif
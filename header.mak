@@ -19,7 +19,7 @@ LIBDIRS =
 # LIBDIRS = -L/home/course/cscix10/lib/links
 
 # common linker options
-LDLIBS = -lGL -lGLEW -lglfw -lm
+LDLIBS = -lGL -lGLEW -lglfw -lm -lpthread
 
 # language-specific linker options
 CLDLIBS =
@@ -27,6 +27,10 @@ CCLDLIBS =
 
 # compiler flags
 CCFLAGS = -ggdb $(INCLUDE) -DGL_GLEXT_PROTOTYPES
+
+# uncomment this to have the Rasterizer walk polygon edges in
+# fixed point (RAST_FIXED_BITS, default 16, sets the precision)
+# CCFLAGS += -DRAST_FIXED_POINT
 CFLAGS = -std=c99 $(CCFLAGS)
 CXXFLAGS = $(CCFLAGS)
 
@@ -13,6 +13,9 @@
 attribute vec4 vPosition;
 attribute vec4 vColor;
 
+// depth kept apart from the position (packed pixels only carry x,y)
+attribute float vDepth;
+
 // scale factors for normalization
 uniform vec2 sf;
 
@@ -25,7 +28,7 @@ void main()
     float x = vPosition.x * sf.x - 1.0;
     float y = vPosition.y * sf.y - 1.0;
 
-    vec4 newvert = vec4( x, y, vPosition.z, vPosition.w );
+    vec4 newvert = vec4( x, y, vPosition.z + vDepth, vPosition.w );
 
     gl_Position = newvert;
     rescolor = vColor;